@@ -0,0 +1,889 @@
+// Floating point to decimal, without locale or allocation.
+//
+// floating2str(v) writes the shortest digits that read back as v,
+// the closest to v of those: Grisu3 (Florian Loitsch, "Printing
+// Floating-Point Numbers Quickly and Accurately with Integers", PLDI
+// 2010) finds them for all but about 0.5% of doubles (0.8% of
+// floats), measured on random bit patterns; the ones it rejects are
+// handled by an exact bignum algorithm (Burger and Dybvig).
+// The layout is that of ECMAScript's Number.prototype.toString:
+// "100", "0.125", "1.5e-7", "1e+21", "-0", "nan", "inf".
+//
+// floating2str_fixed(v, precision) writes v rounded to exactly
+// precision (0 to 17) decimal places, like printf("%.*f"), for
+// |v| < 10^21; larger values are written as by floating2str, as
+// ECMAScript's toFixed does.
+//
+// scaled2str<Denominator>(ticks) writes the exact decimal value of
+// ticks / Denominator for an integer count of ticks, without
+// trailing zeros; Denominator must divide 10^18. Prices held in
+// 1/160000 units are written by scaled2str<160000>.
+#ifndef FILE_floating2str_hpp_INCLUDED_H5W2C8PZ3
+#define FILE_floating2str_hpp_INCLUDED_H5W2C8PZ3
+
+#include "integral2str.hpp"
+#include <algorithm>
+#include <cstring>
+
+struct diyfp // f * 2^e
+{
+    boost::uint64_t f;
+    int e;
+};
+
+inline diyfp make_diyfp(boost::uint64_t f, int e)
+{
+    diyfp result = { f, e };
+    return result;
+}
+
+// The high 64 bits of the 128-bit product x.f * y.f, rounded.
+inline diyfp diyfp_mul(diyfp x, diyfp y)
+{
+    boost::uint64_t const mask = 0xffffffffu;
+    boost::uint64_t const a = x.f >> 32, b = x.f & mask;
+    boost::uint64_t const c = y.f >> 32, d = y.f & mask;
+
+    boost::uint64_t const ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    boost::uint64_t const mid = (bd >> 32) + (ad & mask) + (bc & mask) + (1u << 31);
+
+    return make_diyfp(ac + (ad >> 32) + (bc >> 32) + (mid >> 32), x.e + y.e + 64);
+}
+
+inline diyfp diyfp_normalize(diyfp x) // x.f != 0
+{
+    int const shift = 63 - log2_floor(x.f);
+    return make_diyfp(x.f << shift, x.e - shift);
+}
+
+// v and the midpoints to its neighbours, m_minus and m_plus, with
+// m_minus and m_plus normalized to the same exponent.
+struct float_boundaries
+{
+    diyfp v, m_minus, m_plus;
+};
+
+template<class T> // T is float or double
+struct float_layout
+{
+    BOOST_STATIC_ASSERT(std::numeric_limits<T>::is_iec559);
+
+    typedef typename boost::mpl::if_c<
+        (sizeof(T) == 4), boost::uint32_t, boost::uint64_t
+        >::type bits_type;
+
+    BOOST_STATIC_CONSTANT(int, precision = std::numeric_limits<T>::digits); // hidden bit included
+    BOOST_STATIC_CONSTANT(int, bias = std::numeric_limits<T>::max_exponent - 1 + precision - 1);
+    BOOST_STATIC_CONSTANT(int, min_exp = 1 - bias);
+
+    // std::numeric_limits<T>::max_digits10, which C++03 lacks
+    BOOST_STATIC_CONSTANT(int, max_digits10 = 2 + precision * 30103 / 100000);
+
+    static bits_type bits(T v)
+    {
+        bits_type result;
+        std::memcpy(&result, &v, sizeof(result));
+        return result;
+    }
+
+    // v = f * 2^e exactly, for finite v >= 0.
+    static diyfp decompose(T v)
+    {
+        bits_type const hidden = bits_type(1) << (precision - 1);
+        bits_type const b = bits(v) & ~(bits_type(1) << (sizeof(T) * 8 - 1));
+        bits_type const biased = b >> (precision - 1);
+        bits_type const fraction = b & (hidden - 1);
+
+        return biased == 0 ? make_diyfp(fraction, min_exp)
+                           : make_diyfp(fraction + hidden, int(biased) - bias);
+    }
+
+    static float_boundaries boundaries(T v) // v > 0, finite
+    {
+        diyfp const w = decompose(v);
+
+        // The lower neighbour is closer when v is a power of 2 above
+        // the smallest normal.
+        bool const lower_closer = (bits(v) & ((bits_type(1) << (precision - 1)) - 1)) == 0 &&
+                                  (bits(v) >> (precision - 1)) > 1;
+
+        diyfp const m_plus = diyfp_normalize(make_diyfp(2 * w.f + 1, w.e - 1));
+        diyfp const m_minus = lower_closer ? make_diyfp(4 * w.f - 1, w.e - 2)
+                                           : make_diyfp(2 * w.f - 1, w.e - 1);
+
+        float_boundaries result;
+        result.v = diyfp_normalize(w);
+        result.m_plus = m_plus;
+        result.m_minus = make_diyfp(m_minus.f << (m_minus.e - m_plus.e), m_plus.e);
+        return result;
+    }
+};
+
+struct cached_power // c = f * 2^e ~= 10^k
+{
+    boost::uint64_t f;
+    int e;
+    int k;
+};
+
+// A power of ten c such that the binary exponent of w * c is in
+// [-60, -32] for a normalized w = f * 2^e, so that the integral part
+// of w * c fits in 32 bits.
+inline cached_power cached_power_for(int e)
+{
+    static cached_power const table[] = {
+            { 0xAB70FE17C79AC6CAull, -1060, -300 },
+            { 0xFF77B1FCBEBCDC4Full, -1034, -292 },
+            { 0xBE5691EF416BD60Cull, -1007, -284 },
+            { 0x8DD01FAD907FFC3Cull,  -980, -276 },
+            { 0xD3515C2831559A83ull,  -954, -268 },
+            { 0x9D71AC8FADA6C9B5ull,  -927, -260 },
+            { 0xEA9C227723EE8BCBull,  -901, -252 },
+            { 0xAECC49914078536Dull,  -874, -244 },
+            { 0x823C12795DB6CE57ull,  -847, -236 },
+            { 0xC21094364DFB5637ull,  -821, -228 },
+            { 0x9096EA6F3848984Full,  -794, -220 },
+            { 0xD77485CB25823AC7ull,  -768, -212 },
+            { 0xA086CFCD97BF97F4ull,  -741, -204 },
+            { 0xEF340A98172AACE5ull,  -715, -196 },
+            { 0xB23867FB2A35B28Eull,  -688, -188 },
+            { 0x84C8D4DFD2C63F3Bull,  -661, -180 },
+            { 0xC5DD44271AD3CDBAull,  -635, -172 },
+            { 0x936B9FCEBB25C996ull,  -608, -164 },
+            { 0xDBAC6C247D62A584ull,  -582, -156 },
+            { 0xA3AB66580D5FDAF6ull,  -555, -148 },
+            { 0xF3E2F893DEC3F126ull,  -529, -140 },
+            { 0xB5B5ADA8AAFF80B8ull,  -502, -132 },
+            { 0x87625F056C7C4A8Bull,  -475, -124 },
+            { 0xC9BCFF6034C13053ull,  -449, -116 },
+            { 0x964E858C91BA2655ull,  -422, -108 },
+            { 0xDFF9772470297EBDull,  -396, -100 },
+            { 0xA6DFBD9FB8E5B88Full,  -369,  -92 },
+            { 0xF8A95FCF88747D94ull,  -343,  -84 },
+            { 0xB94470938FA89BCFull,  -316,  -76 },
+            { 0x8A08F0F8BF0F156Bull,  -289,  -68 },
+            { 0xCDB02555653131B6ull,  -263,  -60 },
+            { 0x993FE2C6D07B7FACull,  -236,  -52 },
+            { 0xE45C10C42A2B3B06ull,  -210,  -44 },
+            { 0xAA242499697392D3ull,  -183,  -36 },
+            { 0xFD87B5F28300CA0Eull,  -157,  -28 },
+            { 0xBCE5086492111AEBull,  -130,  -20 },
+            { 0x8CBCCC096F5088CCull,  -103,  -12 },
+            { 0xD1B71758E219652Cull,   -77,   -4 },
+            { 0x9C40000000000000ull,   -50,    4 },
+            { 0xE8D4A51000000000ull,   -24,   12 },
+            { 0xAD78EBC5AC620000ull,     3,   20 },
+            { 0x813F3978F8940984ull,    30,   28 },
+            { 0xC097CE7BC90715B3ull,    56,   36 },
+            { 0x8F7E32CE7BEA5C70ull,    83,   44 },
+            { 0xD5D238A4ABE98068ull,   109,   52 },
+            { 0x9F4F2726179A2245ull,   136,   60 },
+            { 0xED63A231D4C4FB27ull,   162,   68 },
+            { 0xB0DE65388CC8ADA8ull,   189,   76 },
+            { 0x83C7088E1AAB65DBull,   216,   84 },
+            { 0xC45D1DF942711D9Aull,   242,   92 },
+            { 0x924D692CA61BE758ull,   269,  100 },
+            { 0xDA01EE641A708DEAull,   295,  108 },
+            { 0xA26DA3999AEF774Aull,   322,  116 },
+            { 0xF209787BB47D6B85ull,   348,  124 },
+            { 0xB454E4A179DD1877ull,   375,  132 },
+            { 0x865B86925B9BC5C2ull,   402,  140 },
+            { 0xC83553C5C8965D3Dull,   428,  148 },
+            { 0x952AB45CFA97A0B3ull,   455,  156 },
+            { 0xDE469FBD99A05FE3ull,   481,  164 },
+            { 0xA59BC234DB398C25ull,   508,  172 },
+            { 0xF6C69A72A3989F5Cull,   534,  180 },
+            { 0xB7DCBF5354E9BECEull,   561,  188 },
+            { 0x88FCF317F22241E2ull,   588,  196 },
+            { 0xCC20CE9BD35C78A5ull,   614,  204 },
+            { 0x98165AF37B2153DFull,   641,  212 },
+            { 0xE2A0B5DC971F303Aull,   667,  220 },
+            { 0xA8D9D1535CE3B396ull,   694,  228 },
+            { 0xFB9B7CD9A4A7443Cull,   720,  236 },
+            { 0xBB764C4CA7A44410ull,   747,  244 },
+            { 0x8BAB8EEFB6409C1Aull,   774,  252 },
+            { 0xD01FEF10A657842Cull,   800,  260 },
+            { 0x9B10A4E5E9913129ull,   827,  268 },
+            { 0xE7109BFBA19C0C9Dull,   853,  276 },
+            { 0xAC2820D9623BF429ull,   880,  284 },
+            { 0x80444B5E7AA7CF85ull,   907,  292 },
+            { 0xBF21E44003ACDD2Dull,   933,  300 },
+            { 0x8E679C2F5E44FF8Full,   960,  308 },
+            { 0xD433179D9C8CB841ull,   986,  316 },
+            { 0x9E19DB92B4E31BA9ull,  1013,  324 },
+        };
+
+    int const alpha = -60;
+    int const min_dec_exp = -300, dec_step = 8;
+
+    // ceil((alpha - e - 1) * log10(2)); 78913 / 2^18 is just above log10(2)
+    int const f = alpha - e - 1;
+    int const k = (f * 78913) / (1 << 18) + (f > 0);
+    int const index = (-min_dec_exp + k + (dec_step - 1)) / dec_step;
+
+    return table[index];
+}
+
+// Moves the last digit of buf towards w while that stays inside
+// the unsafe interval and gets closer, then tells whether the result
+// is certainly the closest to w inside the true interval; the scaled
+// values are off by less than unit either way (Grisu3's round_weed).
+inline bool grisu3_round_weed(char* buf, int len, boost::uint64_t dist, boost::uint64_t delta,
+                              boost::uint64_t rest, boost::uint64_t ten_k, boost::uint64_t unit)
+{
+    boost::uint64_t const small_dist = dist - unit;
+    boost::uint64_t const big_dist = dist + unit;
+
+    while(rest < small_dist && delta - rest >= ten_k &&
+          (rest + ten_k < small_dist || small_dist - rest >= rest + ten_k - small_dist))
+    {
+        --buf[len - 1];
+        rest += ten_k;
+    }
+
+    // another candidate may be as close, if w is off by a unit
+    if(rest < big_dist && delta - rest >= ten_k &&
+       (rest + ten_k < big_dist || big_dist - rest > rest + ten_k - big_dist))
+        return false;
+
+    // the candidate is inside even if the boundaries are off by a unit
+    return 2 * unit <= rest && rest <= delta - 4 * unit;
+}
+
+// Writes the digits of the shortest number in the interval around w
+// whose boundaries, scaled by the cached power, are m_minus and
+// m_plus, and sets len to their count; the number is buf * 10^exp10.
+// Returns false if the scaling errors leave that undecided.
+inline bool grisu3_digits(char* buf, int& len, int& exp10, diyfp m_minus, diyfp w, diyfp m_plus)
+{
+    // widen the interval by the error of the products: the digits come
+    // from too_high, and are checked against the safe interval after
+    boost::uint64_t unit = 1;
+    boost::uint64_t const too_high = m_plus.f + unit;
+    boost::uint64_t delta = too_high - (m_minus.f - unit);
+    boost::uint64_t const dist = too_high - w.f;
+
+    int const shift = -w.e;
+    boost::uint64_t const one = boost::uint64_t(1) << shift;
+
+    boost::uint32_t p1 = (boost::uint32_t)(too_high >> shift); // integral part
+    boost::uint64_t p2 = too_high & (one - 1);                 // fractional part
+
+    len = 0;
+    int n = digits_10(p1);
+    boost::uint32_t pow10 = (boost::uint32_t)powers_of_10()[n - 1];
+
+    while(n > 0)
+    {
+        boost::uint32_t const d = p1 / pow10;
+        p1 -= d * pow10;
+        buf[len++] = char('0' + d);
+        --n;
+
+        boost::uint64_t const rest = (boost::uint64_t(p1) << shift) + p2;
+        if(rest < delta)
+        {
+            exp10 += n;
+            return grisu3_round_weed(buf, len, dist, delta, rest,
+                                     boost::uint64_t(pow10) << shift, unit);
+        }
+        pow10 /= 10;
+    }
+
+    int m = 0;
+    for(;;)
+    {
+        p2 *= 10;
+        unit *= 10;
+        delta *= 10;
+        buf[len++] = char('0' + (p2 >> shift));
+        p2 &= one - 1;
+        ++m;
+
+        if(p2 < delta)
+        {
+            exp10 -= m;
+            return grisu3_round_weed(buf, len, dist * unit, delta, p2, one, unit);
+        }
+    }
+}
+
+// A nonnegative integer of up to 1280 bits, enough for the scaled
+// values of the exact algorithm below: sum of word[i] * 2^(32 i).
+struct bignum
+{
+    boost::uint32_t word[40];
+    int n; // words in use, the top one nonzero
+
+    explicit bignum(boost::uint64_t v = 0)
+      : n(0)
+    {
+        for(; v != 0; v >>= 32)
+            word[n++] = boost::uint32_t(v);
+    }
+
+    void shift_left(int bits)
+    {
+        if(n == 0)
+            return;
+        int const words = bits / 32;
+        bits %= 32;
+        word[n] = 0;
+        for(int i = n; i >= 0; --i)
+            word[i + words] = (word[i] << bits) |
+                (bits == 0 || i == 0 ? 0 : word[i - 1] >> (32 - bits));
+        for(int i = 0; i < words; ++i)
+            word[i] = 0;
+        n += words + 1;
+        if(word[n - 1] == 0)
+            --n;
+    }
+
+    void mul_small(boost::uint32_t m)
+    {
+        boost::uint64_t carry = 0;
+        for(int i = 0; i < n; ++i)
+        {
+            carry += boost::uint64_t(word[i]) * m;
+            word[i] = boost::uint32_t(carry);
+            carry >>= 32;
+        }
+        if(carry != 0)
+            word[n++] = boost::uint32_t(carry);
+    }
+
+    void mul_pow10(int k)
+    {
+        for(; k >= 9; k -= 9)
+            mul_small(1000000000u);
+        if(k > 0)
+            mul_small(boost::uint32_t(powers_of_10()[k]));
+    }
+
+    void sub(bignum const& b) // b <= *this
+    {
+        boost::int64_t borrow = 0;
+        for(int i = 0; i < n; ++i)
+        {
+            borrow += boost::int64_t(word[i]) - (i < b.n ? b.word[i] : 0);
+            word[i] = boost::uint32_t(borrow);
+            borrow >>= 32;
+        }
+        while(n > 0 && word[n - 1] == 0)
+            --n;
+    }
+
+    // -1, 0 or 1 as a + b is less than, equal to or greater than c
+    static int compare_sum(bignum const& a, bignum const& b, bignum const& c)
+    {
+        bignum sum(a);
+        boost::uint64_t carry = 0;
+        int const top = a.n > b.n ? a.n : b.n;
+        for(int i = 0; i < top; ++i)
+        {
+            carry += boost::uint64_t(i < a.n ? a.word[i] : 0) + (i < b.n ? b.word[i] : 0);
+            sum.word[i] = boost::uint32_t(carry);
+            carry >>= 32;
+        }
+        sum.n = top;
+        if(carry != 0)
+            sum.word[sum.n++] = boost::uint32_t(carry);
+        return compare(sum, c);
+    }
+
+    static int compare(bignum const& a, bignum const& b)
+    {
+        if(a.n != b.n)
+            return a.n < b.n ? -1 : 1;
+        for(int i = a.n - 1; i >= 0; --i)
+            if(a.word[i] != b.word[i])
+                return a.word[i] < b.word[i] ? -1 : 1;
+        return 0;
+    }
+};
+
+// floor(e * log10(2)) for |e| < 1650
+inline int floor_log10_pow2(int e)
+{
+    return e >= 0 ? (e * 78913) >> 18 : -((-e * 78913) >> 18) - 1;
+}
+
+// The shortest digits that read back as v, exactly, for the values
+// Grisu3 leaves undecided: the free-format algorithm of Steele and
+// White as refined by Burger and Dybvig, on bignums. The boundaries
+// belong to the interval when v's significand is even, as strtod
+// rounds ties to even; of two closest candidates the even one wins.
+template<class T>
+inline int exact_digits(char* buf, int& exp10, T v) // v > 0, finite
+{
+    typedef float_layout<T> layout;
+    diyfp const w = layout::decompose(v);
+    bool const even = (w.f & 1) == 0;
+    bool const lower_closer = w.f == (boost::uint64_t(1) << (layout::precision - 1)) &&
+                              w.e > layout::min_exp;
+
+    // v = r / s, and the boundaries are v - mm / s and v + mp / s
+    int const e2 = w.e > 0 ? w.e : 0;
+    bignum r(w.f), s(1), mp(1), mm(1);
+    r.shift_left(e2 + 1 + lower_closer);
+    s.shift_left(e2 - w.e + 1 + lower_closer);
+    mp.shift_left(e2 + lower_closer);
+    mm.shift_left(e2);
+
+    // k is the count of integral digits, or one too few
+    int k = floor_log10_pow2(w.e + log2_floor(w.f)) + 1;
+    if(k >= 0)
+        s.mul_pow10(k);
+    else
+    {
+        r.mul_pow10(-k);
+        mp.mul_pow10(-k);
+        mm.mul_pow10(-k);
+    }
+    int const high = bignum::compare_sum(r, mp, s);
+    if(even ? high >= 0 : high > 0)
+    {
+        s.mul_small(10);
+        ++k;
+    }
+
+    int len = 0;
+    for(;;)
+    {
+        r.mul_small(10);
+        mp.mul_small(10);
+        mm.mul_small(10);
+
+        int d = 0;
+        for(; bignum::compare(r, s) >= 0; ++d)
+            r.sub(s);
+
+        int const low = bignum::compare(r, mm);
+        int const high = bignum::compare_sum(r, mp, s);
+        bool const low_ok = even ? low <= 0 : low < 0;
+        bool const high_ok = even ? high >= 0 : high > 0;
+
+        if(low_ok && high_ok)
+        {
+            int const half = bignum::compare_sum(r, r, s);
+            d += half > 0 || (half == 0 && (d & 1));
+        }
+        else if(high_ok)
+            ++d;
+
+        buf[len++] = char('0' + d);
+        if(low_ok || high_ok)
+            break;
+    }
+
+    exp10 = k - len;
+    return len;
+}
+
+template<class T>
+inline int shortest_digits(char* buf, int& exp10, T v) // v > 0, finite
+{
+    float_boundaries const b = float_layout<T>::boundaries(v);
+    cached_power const c = cached_power_for(b.m_plus.e);
+    diyfp const c_minus_k = make_diyfp(c.f, c.e);
+
+    diyfp const w = diyfp_mul(b.v, c_minus_k);
+    diyfp const w_minus = diyfp_mul(b.m_minus, c_minus_k);
+    diyfp const w_plus = diyfp_mul(b.m_plus, c_minus_k);
+
+    int len;
+    exp10 = -c.k;
+    if(grisu3_digits(buf, len, exp10, w_minus, w, w_plus))
+        return len;
+    return exact_digits(buf, exp10, v);
+}
+
+// digits[0, len) * 10^exp10 laid out as ECMAScript does.
+inline char* put_decimal(char const* digits, int len, int exp10, char* str)
+{
+    int const n = len + exp10; // position of the decimal point
+
+    if(len <= n && n <= 21) // 1234e5 -> 123400000
+    {
+        std::memcpy(str, digits, len);
+        std::memset(str + len, '0', n - len);
+        return str + n;
+    }
+
+    if(0 < n && n <= 21) // 1234e-2 -> 12.34
+    {
+        std::memcpy(str, digits, n);
+        str[n] = '.';
+        std::memcpy(str + n + 1, digits + n, len - n);
+        return str + len + 1;
+    }
+
+    if(-6 < n && n <= 0) // 1234e-6 -> 0.001234
+    {
+        str[0] = '0';
+        str[1] = '.';
+        std::memset(str + 2, '0', -n);
+        std::memcpy(str + 2 - n, digits, len);
+        return str + 2 - n + len;
+    }
+
+    // 1234e-10 -> 1.234e-7, 1e+30
+    *str++ = digits[0];
+    if(len > 1)
+    {
+        *str++ = '.';
+        std::memcpy(str, digits + 1, len - 1);
+        str += len - 1;
+    }
+    *str++ = 'e';
+    *str++ = n - 1 < 0 ? '-' : '+';
+    return unsigned2str_1_4(n - 1 < 0 ? 1 - n : n - 1, str);
+}
+
+// Writes nan, inf or -inf and returns the end, or returns 0 for
+// finite v.
+template<class T>
+inline char* put_special(T v, char* str)
+{
+    if(v != v)
+    {
+        std::memcpy(str, "nan", 3);
+        return str + 3;
+    }
+    if(v - v != v - v)
+    {
+        if(v < 0)
+            *str++ = '-';
+        std::memcpy(str, "inf", 3);
+        return str + 3;
+    }
+    return 0;
+}
+
+// Writes v without the terminating '\0' and returns the end.
+template<class T>
+inline char* floating2str_write(T v, char* str)
+{
+    if(char* end = put_special(v, str))
+        return end;
+
+    if(float_layout<T>::bits(v) >> (sizeof(T) * 8 - 1))
+    {
+        *str++ = '-';
+        v = -v;
+    }
+
+    if(v == 0)
+    {
+        *str = '0';
+        return str + 1;
+    }
+
+    char digits[float_layout<T>::max_digits10 + 1];
+    int exp10;
+    int const len = shortest_digits(digits, exp10, v);
+    return put_decimal(digits, len, exp10, str);
+}
+
+// hi:lo = a * b
+inline void mul_64x64(boost::uint64_t a, boost::uint64_t b,
+                      boost::uint64_t& hi, boost::uint64_t& lo)
+{
+    boost::uint64_t const mask = 0xffffffffu;
+    boost::uint64_t const ah = a >> 32, al = a & mask;
+    boost::uint64_t const bh = b >> 32, bl = b & mask;
+
+    boost::uint64_t const ll = al * bl, lh = al * bh, hl = ah * bl, hh = ah * bh;
+    boost::uint64_t const mid = (ll >> 32) + (lh & mask) + (hl & mask);
+
+    lo = (mid << 32) | (ll & mask);
+    hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+}
+
+// round(f * 2^e * 10^precision), ties to even, into n; false if
+// that doesn't fit in 64 bits.
+inline bool scale_round(diyfp v, int precision, boost::uint64_t& n)
+{
+    boost::uint64_t hi, lo;
+    mul_64x64(v.f, powers_of_10()[precision], hi, lo);
+
+    if(v.e >= 0)
+    {
+        if(hi != 0 || (v.e > 0 && (v.e >= 64 || (lo >> (64 - v.e)) != 0)))
+            return false;
+        n = lo << v.e;
+        return true;
+    }
+
+    int const s = -v.e;
+    if(s > 128) // hi:lo < 2^110, below half a unit
+    {
+        n = 0;
+        return true;
+    }
+
+    // q = hi:lo >> s; compare the bits shifted out, rem, with half
+    boost::uint64_t q, rem_hi, rem_lo, half_hi, half_lo;
+    if(s < 64)
+    {
+        if((hi >> s) != 0)
+            return false;
+        q = (lo >> s) | (hi << (64 - s));
+        rem_hi = 0;
+        rem_lo = lo & ((boost::uint64_t(1) << s) - 1);
+        half_hi = 0;
+        half_lo = boost::uint64_t(1) << (s - 1);
+    }
+    else if(s == 64)
+    {
+        q = hi;
+        rem_hi = 0;
+        rem_lo = lo;
+        half_hi = 0;
+        half_lo = boost::uint64_t(1) << 63;
+    }
+    else
+    {
+        q = s == 128 ? 0 : hi >> (s - 64);
+        rem_hi = s == 128 ? hi : hi & ((boost::uint64_t(1) << (s - 64)) - 1);
+        rem_lo = lo;
+        half_hi = boost::uint64_t(1) << (s - 65);
+        half_lo = 0;
+    }
+
+    bool const above = rem_hi != half_hi ? rem_hi > half_hi : rem_lo > half_lo;
+    bool const tie = rem_hi == half_hi && rem_lo == half_lo;
+    if(above || (tie && (q & 1)))
+    {
+        if(q == (std::numeric_limits<boost::uint64_t>::max)())
+            return false;
+        ++q;
+    }
+    n = q;
+    return true;
+}
+
+// Writes the integer v = f * 2^e, e >= 0 and v < 10^21, and
+// returns the end.
+inline char* put_integral(diyfp v, char* str)
+{
+    // Move the exponent into f as far as 2^53, for floats too.
+    int const k = (std::min)(v.e, v.f == 0 ? 0 : 52 - log2_floor(v.f));
+    if(k > 0)
+    {
+        v.f <<= k;
+        v.e -= k;
+    }
+    if(v.e <= 11) // f < 2^53
+        return unsigned2str_20(v.f << v.e, str);
+
+    // f * 2^e < 10^21 is past 64 bits: split f at 10^10 so that
+    // both halves times 2^e (e <= 17) still fit.
+    boost::uint64_t const e10 = powers_of_10()[10];
+    boost::uint64_t const lo = (v.f % e10) << v.e;
+    boost::uint64_t const hi = ((v.f / e10) << v.e) + lo / e10;
+    boost::uint64_t const rest = lo % e10;
+    str = unsigned2str_20(hi, str);
+    str = put_pair(boost::uint32_t(rest / 100000000u), str);
+    return unsigned2str_8(boost::uint32_t(rest % 100000000u), str);
+}
+
+// Writes v rounded to precision places without the terminating
+// '\0' and returns the end.
+template<class T>
+inline char* floating2str_fixed_write(T v, int precision, char* str)
+{
+    if(char* end = put_special(v, str))
+        return end;
+
+    precision = precision < 0 ? 0 : precision > 17 ? 17 : precision;
+
+    bool const neg = float_layout<T>::bits(v) >> (sizeof(T) * 8 - 1);
+    diyfp const w = float_layout<T>::decompose(neg ? -v : v);
+    boost::uint64_t n;
+    if(!scale_round(w, precision, n))
+    {
+        if((neg ? -v : v) >= T(1e21))
+            return floating2str_write(v, str);
+
+        // v * 10^precision is past 64 bits, so v >= 2^64 / 10^17:
+        // the integral part has at least 3 digits and the fraction,
+        // if any, fewer than 53 - 7 bits. Round the fraction alone.
+        if(neg)
+            *str++ = '-';
+
+        diyfp ip = w;
+        boost::uint64_t frac = 0;
+        if(w.e < 0)
+        {
+            frac = w.f & ((boost::uint64_t(1) << -w.e) - 1);
+            ip.f = w.f >> -w.e;
+            ip.e = 0;
+            scale_round(make_diyfp(frac, w.e), precision, frac); // < 10^precision, fits
+            if(frac == powers_of_10()[precision])
+            {
+                frac = 0;
+                ++ip.f;
+            }
+        }
+        str = put_integral(ip, str);
+        if(precision == 0)
+            return str;
+        *str++ = '.';
+
+        char digits[20];
+        int const len = int(unsigned2str_20(frac, digits) - digits);
+        std::memset(str, '0', precision - len);
+        std::memcpy(str + precision - len, digits, len);
+        return str + precision;
+    }
+
+    if(neg)
+        *str++ = '-';
+
+    char digits[20];
+    int const len = int(unsigned2str_20(n, digits) - digits);
+    int const whole = len - precision;
+
+    if(whole <= 0)
+    {
+        *str++ = '0';
+        if(precision == 0)
+            return str;
+        *str++ = '.';
+        std::memset(str, '0', -whole);
+        std::memcpy(str - whole, digits, len);
+        return str + precision;
+    }
+
+    std::memcpy(str, digits, whole);
+    str += whole;
+    if(precision == 0)
+        return str;
+    *str++ = '.';
+    std::memcpy(str, digits + whole, precision);
+    return str + precision;
+}
+
+template<class T>
+struct resultof_floating2str
+{
+    BOOST_STATIC_ASSERT(std::numeric_limits<T>::is_iec559);
+
+    // "-" and the longest of 21 integral digits, "0.00000" and
+    // max_digits10 digits, or max_digits10 digits, ".", "e-" and 3
+    // digits of exponent. floating2str_fixed writes at most 21
+    // integral digits, "." and 17 decimals.
+    BOOST_STATIC_CONSTANT(int, longest = 7 + float_layout<T>::max_digits10);
+    BOOST_STATIC_CONSTANT(int, longest_fixed = 21 + 1 + 17);
+
+    typedef boost::array< char
+                        , 1 + (longest > longest_fixed ? longest : longest_fixed) + 1
+                        > type;
+};
+
+#define DEFINE_FLOATING2STR(T)                                  \
+inline resultof_floating2str<T>::type floating2str(T v)         \
+{ resultof_floating2str<T>::type result;                        \
+  *floating2str_write(v, result.c_array()) = '\0';              \
+  return result; }                                              \
+inline resultof_floating2str<T>::type                           \
+floating2str_fixed(T v, int precision)                          \
+{ resultof_floating2str<T>::type result;                        \
+  *floating2str_fixed_write(v, precision, result.c_array()) = '\0'; \
+  return result; }
+
+DEFINE_FLOATING2STR(float)
+DEFINE_FLOATING2STR(double)
+
+#undef DEFINE_FLOATING2STR
+
+template<int K>
+struct pow10_c
+{
+    BOOST_STATIC_CONSTANT(boost::uint64_t, value = 10u * pow10_c<K - 1>::value);
+};
+
+template<>
+struct pow10_c<0>
+{
+    BOOST_STATIC_CONSTANT(boost::uint64_t, value = 1u);
+};
+
+// The fewest decimal places that hold any multiple of 1/D exactly,
+// and the factor from 1/D units to units of the last place.
+template< boost::uint64_t D
+        , int K = 0
+        , bool Exact = (pow10_c<K>::value % D == 0)
+        >
+struct scaled_places : scaled_places<D, K + 1>
+{
+};
+
+template<boost::uint64_t D, int K>
+struct scaled_places<D, K, true>
+{
+    BOOST_STATIC_CONSTANT(int, value = K);
+    BOOST_STATIC_CONSTANT(boost::uint64_t, factor = pow10_c<K>::value / D);
+};
+
+template<boost::uint64_t D>
+struct scaled_places<D, 19, false>
+{
+    BOOST_STATIC_ASSERT(D == 0); // D must divide 10^18
+};
+
+// Writes ticks / Denominator without the terminating '\0' and
+// returns the end.
+template<boost::uint64_t Denominator, class T>
+inline char* scaled2str_write(T ticks, char* str)
+{
+    BOOST_STATIC_ASSERT(std::numeric_limits<T>::is_integer);
+    BOOST_STATIC_ASSERT(std::numeric_limits<T>::digits <= 64);
+
+    typedef scaled_places<Denominator> places;
+
+    if(is_negative(ticks))
+        *str++ = '-';
+
+    boost::uint64_t const un = correct_negative(ticks);
+    boost::uint64_t const whole = un / Denominator;
+    boost::uint64_t frac = (un - whole * Denominator) * places::factor;
+
+    str = unsigned2str_20(whole, str);
+    if(frac == 0)
+        return str;
+
+    *str++ = '.';
+    int len = places::value;
+    while(frac % 10u == 0)
+    {
+        frac /= 10u;
+        --len;
+    }
+    for(int i = len; i > 0; --i, frac /= 10u)
+        str[i - 1] = char('0' + frac % 10u);
+    return str + len;
+}
+
+template<class T, boost::uint64_t Denominator>
+struct resultof_scaled2str
+{
+    BOOST_STATIC_ASSERT(std::numeric_limits<T>::is_integer);
+
+    typedef boost::array< char
+                        , std::numeric_limits<T>::is_signed +
+                          std::numeric_limits<T>::digits10 + 1 +
+                          1 + scaled_places<Denominator>::value + 1
+                        > type;
+};
+
+template<boost::uint64_t Denominator, class T>
+inline typename resultof_scaled2str<T, Denominator>::type scaled2str(T ticks)
+{
+    typename resultof_scaled2str<T, Denominator>::type result;
+    *scaled2str_write<Denominator>(ticks, result.c_array()) = '\0';
+    return result;
+}
+
+#endif // #ifndef FILE_floating2str_hpp_INCLUDED_H5W2C8PZ3
@@ -0,0 +1,183 @@
+// Regression tests for floating2str.hpp.
+//
+// Checks floating2str_fixed against printf("%.*f"), which rounds
+// the exact binary value the same way, and that floating2str
+// round-trips through strtod with the fewest digits that do.
+// Prints each failed check and exits non-zero if any failed.
+//
+// g++ -O2 -I $BOOST_ROOT floating2str_test.cpp
+
+#include "floating2str.hpp"
+#include "test_support.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// floating2str_fixed(v, precision) has to be printf's "%.*f" below
+// 10^21, whatever the magnitude of v * 10^precision.
+bool same_as_printf(double v, int precision)
+{
+    char expected[400];
+    std::sprintf(expected, "%.*f", precision, v);
+    bool const same = std::strcmp(floating2str_fixed(v, precision).data(), expected) == 0;
+    if(!same)
+        std::cout << "  " << expected << " at " << precision
+                  << ": got " << floating2str_fixed(v, precision).data() << '\n';
+    return same;
+}
+
+bool same_as_printf(float v, int precision)
+{
+    char expected[400];
+    std::sprintf(expected, "%.*f", precision, double(v));
+    return std::strcmp(floating2str_fixed(v, precision).data(), expected) == 0;
+}
+
+void test_fixed()
+{
+    CHECK(std::strcmp(floating2str_fixed(200.0, 17).data(), "200.00000000000000000") == 0);
+    CHECK(std::strcmp(floating2str_fixed(1e19, 2).data(), "10000000000000000000.00") == 0);
+    CHECK(std::strcmp(floating2str_fixed(-56367.231744968936, 15).data(), "-56367.231744968936255") == 0);
+    CHECK(std::strcmp(floating2str_fixed(0.125, 2).data(), "0.12") == 0);
+    CHECK(std::strcmp(floating2str_fixed(1.5, 0).data(), "2") == 0);
+    CHECK(std::strcmp(floating2str_fixed(-0.0, 1).data(), "-0.0") == 0);
+    CHECK(std::strcmp(floating2str_fixed(1e21, 2).data(), "1e+21") == 0);
+    CHECK(std::strcmp(floating2str_fixed(999999999999999.9, 0).data(), "1000000000000000") == 0);
+
+    double const values[] = {
+        0.1, 1.0 / 3, 2.5, 184.46744073709552, 12345.678901234567,
+        1e15, 1.2345678901234567e15, 9007199254740993.0, 1e16 + 2,
+        1e17, 3.14159e18, 1.8446744073709552e19, 1e20, 9.999999999999999e20,
+        123456789.98765432, 4503599627370495.5
+    };
+    for(std::size_t i = 0; i < sizeof(values) / sizeof(*values); ++i)
+        for(int precision = 0; precision <= 17; ++precision)
+        {
+            CHECK(same_as_printf(values[i], precision));
+            CHECK(same_as_printf(-values[i], precision));
+            if(float(values[i]) < 1e21f)
+                CHECK(same_as_printf(float(values[i]), precision));
+        }
+}
+
+// Values with 53 significant bits from 2^49 (5.6e14) up to 1e21.
+void test_fixed_large()
+{
+    boost::uint64_t seed = 12345;
+    for(int i = 0; i < 20000; ++i)
+    {
+        next_random(seed);
+        double const v = std::ldexp(double((seed >> 11) | (boost::uint64_t(1) << 52)),
+                                    int(seed % 21) - 3);
+        if(v >= 1e21)
+            continue;
+        CHECK(same_as_printf(v, int((seed >> 5) % 18)));
+    }
+}
+
+// The fewest significant digits that read back as v: printf's
+// "%.*e" rounds exactly, so the first precision that round-trips
+// is the shortest.
+int shortest_length(double v)
+{
+    char str[40];
+    for(int digits = 1; digits < 17; ++digits)
+    {
+        std::sprintf(str, "%.*e", digits - 1, v);
+        if(std::strtod(str, 0) == v)
+            return digits;
+    }
+    return 17;
+}
+
+int shortest_length(float v)
+{
+    char str[40];
+    for(int digits = 1; digits < 9; ++digits)
+    {
+        std::sprintf(str, "%.*e", digits - 1, double(v));
+        if(std::strtof(str, 0) == v)
+            return digits;
+    }
+    return 9;
+}
+
+// The significant digits of floating2str's output, without the sign,
+// the point, the exponent and the zeros on either side.
+int significant_digits(char const* str)
+{
+    std::string digits;
+    for(; *str != '\0' && *str != 'e'; ++str)
+        if('0' <= *str && *str <= '9')
+            digits += *str;
+    std::string::size_type const first = digits.find_first_not_of('0');
+    std::string::size_type const last = digits.find_last_not_of('0');
+    return first == std::string::npos ? 1 : int(last - first + 1);
+}
+
+double read_back(char const* str, double) { return std::strtod(str, 0); }
+float read_back(char const* str, float) { return std::strtof(str, 0); }
+
+template<class T>
+bool shortest_round_trip(T v)
+{
+    typename resultof_floating2str<T>::type const str = floating2str(v);
+    bool const same = read_back(str.data(), v) == v &&
+                      significant_digits(str.data()) == shortest_length(v);
+    if(!same)
+        std::cout << "  " << str.data() << ": " << shortest_length(v) << " digits\n";
+    return same;
+}
+
+void test_shortest()
+{
+    double const values[] = {
+        0.1, 0.3, 1e21, 1e23, 5e-324, 2.2250738585072014e-308, 1.7976931348623157e308,
+        123.456, 1e15, 9007199254740993.0,
+        // Grisu2 wrote these with a digit more than needed
+        2.718316374298659e276, 30892612233637950.0, 1.830525276903402e208,
+        66766885433589620.0, 5.270283416880071e-247
+    };
+    for(std::size_t i = 0; i < sizeof(values) / sizeof(*values); ++i)
+        CHECK(shortest_round_trip(values[i]));
+    CHECK(std::strcmp(floating2str(100.0).data(), "100") == 0);
+    CHECK(std::strcmp(floating2str(1e21).data(), "1e+21") == 0);
+    CHECK(std::strcmp(floating2str(1e23).data(), "1e+23") == 0);
+    CHECK(std::strcmp(floating2str(30892612233637950.0).data(), "30892612233637950") == 0);
+
+    // random bit patterns, of which Grisu3 leaves about 0.5% of the
+    // doubles and 0.8% of the floats to the exact algorithm
+    boost::uint64_t seed = 54321;
+    for(int i = 0; i < 100000; ++i)
+    {
+        next_random(seed);
+        double d;
+        std::memcpy(&d, &seed, sizeof(d));
+        if(d == d && d - d == 0)
+            CHECK(shortest_round_trip(d));
+
+        boost::uint32_t const bits = boost::uint32_t(seed >> 32);
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        if(f == f && f - f == 0)
+            CHECK(shortest_round_trip(f));
+    }
+}
+
+int main()
+{
+    test_fixed();
+    test_fixed_large();
+    test_shortest();
+    return test_result();
+}
+
+/*
+ * Distributed under the Boost Software License, Version 1.0. (See
+ * accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
@@ -8,6 +8,7 @@
 #include <boost/mpl/deref.hpp>
 #include <boost/mpl/find_if.hpp>
 #include <boost/mpl/greater.hpp>
+#include <boost/mpl/if.hpp>
 #include <boost/mpl/vector_c.hpp>
 #include <boost/static_assert.hpp>
 #include <limits>
@@ -41,57 +42,136 @@ inline int digits_5(T un) // un in [-99999, 99999]
         return un < 1000u ? 3 : 4 + hibit(9999u - un);
 }
 
-// TODO: measure performance of nlz-based
-// (number of leading zeros) implementations.
-#if 0
-template<class T>          // T is unsigned type
-inline int digits_10(T un) // un in [9999999999, -9999999999]
+inline int log2_floor(boost::uint32_t un) // un != 0
 {
-    // TODO: read about bsrl. IIRC, its result is UB when un == 0
-    int msb_pos; // position of most significant bit
-    __asm__ ("bsrl %1, %0" : "=r" (msb_pos) : "r" (un));
+#if defined(__GNUC__)
+    return 31 - __builtin_clz(un); // lzcnt or bsr
+#else
+    int n = 0;
+    while(un >>= 1)
+        ++n;
+    return n;
+#endif
+}
 
-    // The alrothim is copied from http://www.hackersdelight.org
+inline int log2_floor(boost::uint64_t un) // un != 0
+{
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(un);
+#else
+    boost::uint32_t hi = (boost::uint32_t)(un >> 32);
+    return hi ? 32 + log2_floor(hi) : log2_floor((boost::uint32_t)un);
+#endif
+}
 
-    static unsigned int table[11] = { 0, 9, 99, 999, 9999, 99999,
-            999999, 9999999, 99999999, 999999999, 0xffffffff
+inline boost::uint64_t const* powers_of_10()
+{
+    static boost::uint64_t const table[20] = { 1ull, 10ull, 100ull,
+            1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+            100000000ull, 1000000000ull, 10000000000ull,
+            100000000000ull, 1000000000000ull, 10000000000000ull,
+            100000000000000ull, 1000000000000000ull,
+            10000000000000000ull, 100000000000000000ull,
+            1000000000000000000ull, 10000000000000000000ull
         };
+    return table;
+}
 
-    int x = (19 * msb_pos) >> 6;
-    return 1 + x + ((table[x + 1] - un) >> 31);
+template<class T>          // T is unsigned type
+inline int digits_10(T un) // un in [0, 2^64)
+{
+    BOOST_STATIC_ASSERT(!std::numeric_limits<T>::is_signed);
+    BOOST_STATIC_ASSERT(std::numeric_limits<T>::digits <= 64);
+
+    // The alrothim is copied from http://www.hackersdelight.org:
+    // 1233/4096 is just above log10(2), so x is log10 of the bit
+    // length's power of 2, and one comparison finishes the job.
+    // un | 1 has as many digits as un and a defined log2.
+    typedef typename boost::mpl::if_c<
+        (std::numeric_limits<T>::digits <= 32), boost::uint32_t, boost::uint64_t
+        >::type word;
+
+    word const w = word(un) | 1u;
+    int const x = ((log2_floor(w) + 1) * 1233) >> 12;
+    return x + (w >= powers_of_10()[x]);
 }
+
+// Which digits_* integral2str uses to count the digits of values
+// below 10^5: comparisons (digits_5) or the leading zero count
+// (digits_10). integral2str_digits_bench.cpp times both. Counting
+// alone, digits_10 wins on short values. But the count feeds the
+// switch in unsigned2str_5, and timed that way digits_5 was faster
+// for every type and distribution except uniform unsigned char,
+// where it lost less than it gained on skewed unsigned char (gcc 12,
+// x86-64). So digits_use_nlz is false for every type.
+// Specialize for a type, or define INTEGRAL2STR_DIGITS_NLZ to 0
+// or 1, to override the choice.
+template<class T>
+struct digits_use_nlz
+{
+#if defined(INTEGRAL2STR_DIGITS_NLZ)
+    BOOST_STATIC_CONSTANT(bool, value = INTEGRAL2STR_DIGITS_NLZ);
+#else
+    BOOST_STATIC_CONSTANT(bool, value = false);
 #endif
+};
+
+template<class T> // T is unsigned type
+inline int digits_upto_5(T un)
+{
+    return digits_use_nlz<T>::value ? digits_10(un) : digits_5(un);
+}
+
+// Digits are written two per step from a table of the pairs
+// "00" to "99".
+inline char const* digit_pairs()
+{
+    static char const table[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+    return table;
+}
+
+inline char* put_pair(boost::uint32_t n, char* str) // n in [0, 99]
+{
+    char const* pair = digit_pairs() + 2 * n;
+    str[0] = pair[0];
+    str[1] = pair[1];
+    return str + 2;
+}
 
 template<class T> // T is unsigned type
 inline char* unsigned2str_5(T un, char* str, int digits)
 {
     BOOST_STATIC_ASSERT(!std::numeric_limits<T>::is_signed);
 
-    unsigned int digit;
-
-    boost::uint_least32_t const multiplier4 = 8389;
+    boost::uint32_t n = un, hi;
 
-    // TODO: better parallelism
+    // After the odd leading digit the rest goes in pairs, and
+    // the two lookups of a 4-digit tail don't wait for each other.
     switch(digits)
     {
         case 5:
-            digit = un / 10000u; // 32bits is not enough for (un*0x1a36f)>>30
-            *str++ = '0' + digit;
-            un -= 10000u * digit;
+            hi = n / 10000u; // 32bits is not enough for (un*0x1a36f)>>30
+            *str++ = '0' + hi;
+            n -= 10000u * hi;
+            // fall through
         case 4:
-            digit = (un * multiplier4) >> 23;
-            *str++ = '0' + digit;
-            un -= digit * 1000u;
+            hi = (n * 5243u) >> 19; // n / 100
+            put_pair(hi, str);
+            return put_pair(n - hi * 100u, str + 2);
         case 3:
-            digit = (un * 41u) >> 12;
-            *str++ = '0' + digit;
-            un -= digit * 100u;
+            hi = (n * 5243u) >> 19;
+            *str++ = '0' + hi;
+            return put_pair(n - hi * 100u, str);
         case 2:
-            digit = (un * 103u) >> 10;
-            *str++ = '0' + digit;
-            un -= digit * 10u;
+            return put_pair(n, str);
         case 1:
-            *str++ = '0' + un;
+            *str = '0' + n;
+            return str + 1;
     }
 
     return str;
@@ -108,14 +188,116 @@ inline char* unsigned2str_10(T un, char* str)
     T hi = un / 100000u;
 
     if(hi == 0)
-        return unsigned2str_5(un, str, digits_5(un));
+        return unsigned2str_5(un, str, digits_upto_5(un));
     else
     {
-        str = unsigned2str_5(hi, str, digits_5(hi));
+        str = unsigned2str_5(hi, str, digits_upto_5(hi));
         return unsigned2str_5( un % 100000u, str, 5);
     }
 }
 
+// Wider types are written in chunks of 8 digits. Divisions by
+// 100 and 10000 within a chunk are multiply-shifts, exact for
+// the ranges they are used on.
+inline char* unsigned2str_4(boost::uint32_t un, char* str) // exactly 4 digits
+{
+    boost::uint32_t hi = (un * 5243u) >> 19; // un / 100 for un < 43699
+    put_pair(hi, str);
+    return put_pair(un - hi * 100u, str + 2);
+}
+
+inline char* unsigned2str_8(boost::uint32_t un, char* str) // exactly 8 digits
+{
+    // un / 10000 for un < 10^8
+    boost::uint32_t hi = (boost::uint32_t)((boost::uint64_t(un) * 109951163u) >> 40);
+    str = unsigned2str_4(hi, str);
+    return unsigned2str_4(un - hi * 10000u, str);
+}
+
+inline char* unsigned2str_1_4(boost::uint32_t un, char* str) // un in [0, 9999]
+{
+    if(un < 100u)
+    {
+        if(un < 10u)
+        {
+            *str = '0' + un;
+            return str + 1;
+        }
+        return put_pair(un, str);
+    }
+
+    boost::uint32_t hi = (un * 5243u) >> 19;
+    if(hi < 10u)
+        *str++ = '0' + hi;
+    else
+        str = put_pair(hi, str);
+    return put_pair(un - hi * 100u, str);
+}
+
+inline char* unsigned2str_1_8(boost::uint32_t un, char* str) // un in [0, 99999999]
+{
+    if(un < 10000u)
+        return unsigned2str_1_4(un, str);
+
+    boost::uint32_t hi = (boost::uint32_t)((boost::uint64_t(un) * 109951163u) >> 40);
+    str = unsigned2str_1_4(hi, str);
+    return unsigned2str_4(un - hi * 10000u, str);
+}
+
+inline char* unsigned2str_20(boost::uint64_t un, char* str)
+{
+    boost::uint64_t const e8 = 100000000u;
+
+    if(un < e8)
+        return unsigned2str_1_8((boost::uint32_t)un, str);
+
+    if(un < e8 * e8)
+    {
+        boost::uint64_t hi = un / e8;
+        str = unsigned2str_1_8((boost::uint32_t)hi, str);
+        return unsigned2str_8((boost::uint32_t)(un - hi * e8), str);
+    }
+
+    boost::uint64_t hi = un / (e8 * e8); // at most 4 digits
+    boost::uint64_t lo = un - hi * (e8 * e8);
+    boost::uint64_t mid = lo / e8;
+    str = unsigned2str_1_4((boost::uint32_t)hi, str);
+    str = unsigned2str_8((boost::uint32_t)mid, str);
+    return unsigned2str_8((boost::uint32_t)(lo - mid * e8), str);
+}
+
+#if defined(BOOST_HAS_INT128)
+inline char* unsigned2str_16(boost::uint64_t un, char* str) // exactly 16 digits
+{
+    boost::uint64_t hi = un / 100000000u;
+    str = unsigned2str_8((boost::uint32_t)hi, str);
+    return unsigned2str_8((boost::uint32_t)(un - hi * 100000000u), str);
+}
+
+inline char* unsigned2str_39(unsigned __int128 un, char* str)
+{
+    boost::uint64_t const e16 = 10000000000000000ull;
+
+    if(un <= (std::numeric_limits<boost::uint64_t>::max)())
+        return unsigned2str_20((boost::uint64_t)un, str);
+
+    // 128-bit divisions are slow library calls: peel 16 digits
+    // at a time until the rest fits in 64 bits.
+    unsigned __int128 hi = un / e16;
+    boost::uint64_t lo = (boost::uint64_t)(un - hi * e16);
+
+    if(hi <= (std::numeric_limits<boost::uint64_t>::max)())
+        str = unsigned2str_20((boost::uint64_t)hi, str);
+    else
+    {
+        boost::uint64_t top = (boost::uint64_t)(hi / e16); // at most 7 digits
+        str = unsigned2str_1_8((boost::uint32_t)top, str);
+        str = unsigned2str_16((boost::uint64_t)(hi - top * (unsigned __int128)e16), str);
+    }
+    return unsigned2str_16(lo, str);
+}
+#endif
+
 #define INTEGRAL2STR_DEFINE(T)                          \
 inline bool is_negative(T n)          { return n < 0; } \
 inline bool is_negative(unsigned T n) { return false; } \
@@ -127,7 +309,12 @@ inline unsigned T correct_negative(T n)                 \
 // No definitions for types shorter then int
 INTEGRAL2STR_DEFINE(int)
 INTEGRAL2STR_DEFINE(long)
-// TODO: non-standard types
+#if defined(BOOST_HAS_LONG_LONG)
+INTEGRAL2STR_DEFINE(long long)
+#endif
+#if defined(BOOST_HAS_INT128)
+INTEGRAL2STR_DEFINE(__int128)
+#endif
 
 #undef INTEGRAL2STR_DEFINE
 
@@ -162,6 +349,28 @@ struct integral2str_switch<777> // generic impl
     }
 };
 
+#if defined(BOOST_HAS_INT128)
+template<>
+struct integral2str_switch<39>
+{
+    template<class T>
+    inline static char* doit(T un, char* str, std::size_t)
+    {
+       return unsigned2str_39(un, str);
+    }
+};
+#endif
+
+template<>
+struct integral2str_switch<20>
+{
+    template<class T>
+    inline static char* doit(T un, char* str, std::size_t)
+    {
+       return unsigned2str_20(un, str);
+    }
+};
+
 template<>
 struct integral2str_switch<10>
 {
@@ -178,14 +387,14 @@ struct integral2str_switch<5>
     template<class T>
     inline static char* doit(T un, char* str, std::size_t)
     {
-       return unsigned2str_5(un, str, digits_5(un));
+       return unsigned2str_5(un, str, digits_upto_5(un));
     }
 };
 
 
-// Not inline
+// Writes n without the terminating '\0' and returns the end.
 template<class T>
-void integral2str_impl(T n, char* str, std::size_t size)
+inline char* integral2str_write(T n, char* str, std::size_t size)
 {
     using namespace boost;
     using mpl::_;
@@ -193,7 +402,7 @@ void integral2str_impl(T n, char* str, std::size_t size)
     typedef mpl::int_<std::numeric_limits<T>::digits10> digits10;
 
     typedef typename mpl::deref<
-        typename mpl::find_if< mpl::vector_c<int,5,10,777>
+        typename mpl::find_if< mpl::vector_c<int,5,10,20,39,777>
                              , mpl::greater<_,digits10>
                              >::type
         >::type nearest;
@@ -203,9 +412,15 @@ void integral2str_impl(T n, char* str, std::size_t size)
     if(is_negative(n))
         *str++ = '-';
 
-    str = impl::doit(correct_negative(n), str, size);
+    return impl::doit(correct_negative(n), str, size);
     // Note that correct_negative also promotes n
-    *str = '\0';
+}
+
+// Not inline
+template<class T>
+void integral2str_impl(T n, char* str, std::size_t size)
+{
+    *integral2str_write(n, str, size) = '\0';
 }
 
 template<class T>
@@ -234,7 +449,15 @@ DEFINE_INTEGRAL2STR(signed int)
 DEFINE_INTEGRAL2STR(unsigned int)
 DEFINE_INTEGRAL2STR(signed long int)
 DEFINE_INTEGRAL2STR(unsigned long int)
-// TODO: non-standard types
+// boost::int64_t and boost::uint64_t are one of these or of the above
+#if defined(BOOST_HAS_LONG_LONG)
+DEFINE_INTEGRAL2STR(signed long long int)
+DEFINE_INTEGRAL2STR(unsigned long long int)
+#endif
+#if defined(BOOST_HAS_INT128)
+DEFINE_INTEGRAL2STR(signed __int128)
+DEFINE_INTEGRAL2STR(unsigned __int128)
+#endif
 
 #undef DEFINE_INTEGRAL2STR
 
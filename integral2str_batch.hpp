@@ -0,0 +1,235 @@
+// Columns of integers to decimal, many at a time.
+//
+// integral2str_batch(values, n, out, offsets) writes the n values
+// back to back into out, without separators or terminating '\0's;
+// the ith one is [out + offsets[i], out + offsets[i + 1]), so offsets
+// has n + 1 elements. out must have room for n times the longest
+// value: n * (resultof_integral2str<T>::type::static_size - 1).
+//
+// With SSE2 the digits of a value below 10^16 are computed 16 at a
+// time in one register, and with AVX2 those of two values at once;
+// wider values write the digits above the 16th like integral2str.
+// Without them, or for types wider than 64 bits, every value goes
+// through integral2str_write. Define INTEGRAL2STR_NO_SIMD to force
+// the scalar code.
+#ifndef FILE_integral2str_batch_hpp_INCLUDED_K7Q2M9XW4
+#define FILE_integral2str_batch_hpp_INCLUDED_K7Q2M9XW4
+
+#include "integral2str.hpp"
+#include <cstddef>
+#include <cstring>
+
+#if !defined(INTEGRAL2STR_NO_SIMD)
+#  if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define INTEGRAL2STR_SSE2
+#    include <emmintrin.h>
+#  endif
+#  if defined(INTEGRAL2STR_SSE2) && defined(__AVX2__)
+#    define INTEGRAL2STR_AVX2
+#    include <immintrin.h>
+#  endif
+#endif
+
+#if defined(INTEGRAL2STR_SSE2)
+
+// The kernels follow Wojciech Mula's SSE2 itoa: abcdefgh < 10^8 is
+// split into abcd and efgh, each is broadcast to four 16-bit lanes,
+// and multiply-highs by scaled reciprocals of 1000, 100, 10 and 1
+// give [a, ab, abc, abcd, e, ef, efg, efgh]; subtracting ten times
+// each lane's left neighbour leaves one digit per lane.
+
+inline __m128i digits8_sse2(__m128i x) // x = [abcdefgh, 0]
+{
+    __m128i const abcd = _mm_srli_epi64(
+        _mm_mul_epu32(x, _mm_set1_epi32(0xd1b71759)), 45); // x / 10000
+    __m128i const efgh = _mm_sub_epi32(
+        x, _mm_mul_epu32(abcd, _mm_set1_epi32(10000)));
+
+    // [abcd * 4] x 4, [efgh * 4] x 4
+    __m128i const v1 = _mm_slli_epi64(_mm_unpacklo_epi16(abcd, efgh), 2);
+    __m128i const v2a = _mm_unpacklo_epi16(v1, v1);
+    __m128i const v2 = _mm_unpacklo_epi32(v2a, v2a);
+
+    __m128i const v3 = _mm_mulhi_epu16(v2, _mm_setr_epi16(
+        8389, 5243, 13108, (short)0x8000, 8389, 5243, 13108, (short)0x8000));
+    __m128i const v4 = _mm_mulhi_epu16(v3, _mm_setr_epi16(
+        1 << 7, 1 << 11, 1 << 13, (short)0x8000, 1 << 7, 1 << 11, 1 << 13, (short)0x8000));
+
+    __m128i const v5 = _mm_slli_epi64(_mm_mullo_epi16(v4, _mm_set1_epi16(10)), 16);
+    return _mm_sub_epi16(v4, v5);
+}
+
+// The 16 digits of un < 10^16 as characters, leading zeros included.
+inline __m128i ascii16_sse2(boost::uint64_t un)
+{
+    boost::uint32_t hi = (boost::uint32_t)(un / 100000000u);
+    boost::uint32_t lo = (boost::uint32_t)(un - hi * boost::uint64_t(100000000u));
+    __m128i const d = _mm_packus_epi16(
+        digits8_sse2(_mm_cvtsi32_si128(hi)), digits8_sse2(_mm_cvtsi32_si128(lo)));
+    return _mm_add_epi8(d, _mm_set1_epi8('0'));
+}
+
+inline int ctz16(unsigned mask) // mask != 0
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(mask);
+#else
+    int n = 0;
+    for(; (mask & 1u) == 0; mask >>= 1)
+        ++n;
+    return n;
+#endif
+}
+
+// Copies the 16 characters in ascii to str, leading zeros dropped
+// unless all is set; the last digit is always written.
+inline char* put16_sse2(__m128i ascii, char* str, bool all)
+{
+    char buf[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(buf), ascii);
+
+    int skip = 0;
+    if(!all)
+    {
+        unsigned zeros = _mm_movemask_epi8(_mm_cmpeq_epi8(ascii, _mm_set1_epi8('0')));
+        skip = ctz16(~zeros | 0x8000u);
+    }
+    std::memcpy(str, buf + skip, 16 - skip);
+    return str + 16 - skip;
+}
+
+#if defined(INTEGRAL2STR_AVX2)
+// digits8_sse2 on two values, one per 128-bit lane.
+inline __m256i digits8x2_avx2(__m256i x) // x = [abcdefgh, 0 | ABCDEFGH, 0]
+{
+    __m256i const abcd = _mm256_srli_epi64(
+        _mm256_mul_epu32(x, _mm256_set1_epi32(0xd1b71759)), 45);
+    __m256i const efgh = _mm256_sub_epi32(
+        x, _mm256_mul_epu32(abcd, _mm256_set1_epi32(10000)));
+
+    __m256i const v1 = _mm256_slli_epi64(_mm256_unpacklo_epi16(abcd, efgh), 2);
+    __m256i const v2a = _mm256_unpacklo_epi16(v1, v1);
+    __m256i const v2 = _mm256_unpacklo_epi32(v2a, v2a);
+
+    __m256i const v3 = _mm256_mulhi_epu16(v2, _mm256_setr_epi16(
+        8389, 5243, 13108, (short)0x8000, 8389, 5243, 13108, (short)0x8000,
+        8389, 5243, 13108, (short)0x8000, 8389, 5243, 13108, (short)0x8000));
+    __m256i const v4 = _mm256_mulhi_epu16(v3, _mm256_setr_epi16(
+        1 << 7, 1 << 11, 1 << 13, (short)0x8000, 1 << 7, 1 << 11, 1 << 13, (short)0x8000,
+        1 << 7, 1 << 11, 1 << 13, (short)0x8000, 1 << 7, 1 << 11, 1 << 13, (short)0x8000));
+
+    __m256i const v5 = _mm256_slli_epi64(_mm256_mullo_epi16(v4, _mm256_set1_epi16(10)), 16);
+    return _mm256_sub_epi16(v4, v5);
+}
+
+// ascii16_sse2 of a in the low lane and of b in the high lane.
+inline __m256i ascii16x2_avx2(boost::uint64_t a, boost::uint64_t b)
+{
+    boost::uint32_t ahi = (boost::uint32_t)(a / 100000000u);
+    boost::uint32_t alo = (boost::uint32_t)(a - ahi * boost::uint64_t(100000000u));
+    boost::uint32_t bhi = (boost::uint32_t)(b / 100000000u);
+    boost::uint32_t blo = (boost::uint32_t)(b - bhi * boost::uint64_t(100000000u));
+    __m256i const d = _mm256_packus_epi16(
+        digits8x2_avx2(_mm256_setr_epi32(ahi, 0, 0, 0, bhi, 0, 0, 0)),
+        digits8x2_avx2(_mm256_setr_epi32(alo, 0, 0, 0, blo, 0, 0, 0)));
+    return _mm256_add_epi8(d, _mm256_set1_epi8('0'));
+}
+#endif
+
+#endif // INTEGRAL2STR_SSE2
+
+template<bool Fits64> struct integral2str_batch_switch;
+
+template<>
+struct integral2str_batch_switch<false> // scalar impl
+{
+    template<class T>
+    static void doit(T const* values, std::size_t n, char* out, boost::uint32_t* offsets)
+    {
+        char* str = out;
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            offsets[i] = str - out;
+            str = integral2str_write(values[i], str, 0);
+        }
+        offsets[n] = str - out;
+    }
+};
+
+#if defined(INTEGRAL2STR_SSE2)
+template<>
+struct integral2str_batch_switch<true>
+{
+    template<class T>
+    static void doit(T const* values, std::size_t n, char* out, boost::uint32_t* offsets)
+    {
+        char* str = out;
+        std::size_t i = 0;
+
+#if defined(INTEGRAL2STR_AVX2)
+        boost::uint64_t const e16 = 10000000000000000ull;
+        for(; i + 1 < n; i += 2)
+        {
+            boost::uint64_t a = correct_negative(values[i]);
+            boost::uint64_t b = correct_negative(values[i + 1]);
+            if(a >= e16 || b >= e16)
+            {
+                str = one(values[i], str, out, offsets + i);
+                str = one(values[i + 1], str, out, offsets + i + 1);
+                continue;
+            }
+
+            __m256i const ascii = ascii16x2_avx2(a, b);
+            offsets[i] = str - out;
+            if(is_negative(values[i]))
+                *str++ = '-';
+            str = put16_sse2(_mm256_castsi256_si128(ascii), str, false);
+            offsets[i + 1] = str - out;
+            if(is_negative(values[i + 1]))
+                *str++ = '-';
+            str = put16_sse2(_mm256_extracti128_si256(ascii, 1), str, false);
+        }
+#endif
+
+        for(; i < n; ++i)
+            str = one(values[i], str, out, offsets + i);
+        offsets[n] = str - out;
+    }
+
+private:
+    template<class T>
+    static char* one(T n, char* str, char const* out, boost::uint32_t* offset)
+    {
+        boost::uint64_t const e16 = 10000000000000000ull;
+
+        *offset = str - out;
+        if(is_negative(n))
+            *str++ = '-';
+
+        boost::uint64_t un = correct_negative(n);
+        if(un < e16)
+            return put16_sse2(ascii16_sse2(un), str, false);
+
+        boost::uint64_t hi = un / e16; // at most 4 digits
+        str = unsigned2str_1_4((boost::uint32_t)hi, str);
+        return put16_sse2(ascii16_sse2(un - hi * e16), str, true);
+    }
+};
+#endif
+
+template<class T>
+void integral2str_batch(T const* values, std::size_t n, char* out, boost::uint32_t* offsets)
+{
+    BOOST_STATIC_ASSERT(std::numeric_limits<T>::is_integer);
+
+#if defined(INTEGRAL2STR_SSE2)
+    typedef integral2str_batch_switch<(std::numeric_limits<T>::digits <= 64)> impl;
+#else
+    typedef integral2str_batch_switch<false> impl;
+#endif
+
+    impl::doit(values, n, out, offsets);
+}
+
+#endif // #ifndef FILE_integral2str_batch_hpp_INCLUDED_K7Q2M9XW4
+
@@ -0,0 +1,125 @@
+// Regression tests for integral2str_batch.hpp.
+//
+// Checks that each value's slice [offsets[i], offsets[i + 1]) of
+// the output is integral2str of the value, around the powers of 10,
+// the 16-digit split of the SIMD kernels and the limits of each
+// type, for odd and even counts. Prints each failed check and
+// exits non-zero if any failed. Build it once per code path:
+//
+// g++ -O2 -mavx2 -I $BOOST_ROOT integral2str_batch_test.cpp
+// g++ -O2 -I $BOOST_ROOT integral2str_batch_test.cpp    # SSE2 only
+// g++ -O2 -DINTEGRAL2STR_NO_SIMD -I $BOOST_ROOT integral2str_batch_test.cpp
+
+#include "integral2str_batch.hpp"
+#include "test_support.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Converts the first n values in one batch and compares each slice
+// with integral2str.
+template<class T>
+bool same_as_integral2str(std::vector<T> const& values, std::size_t n)
+{
+    std::size_t const longest = resultof_integral2str<T>::type::static_size - 1;
+    std::vector<char> out(n * longest + 1);
+    std::vector<boost::uint32_t> offsets(n + 1, 0xffffffffu);
+    integral2str_batch(n ? &values[0] : (T const*)0, n, &out[0], &offsets[0]);
+
+    bool same = offsets[0] == 0;
+    for(std::size_t i = 0; i < n; ++i)
+    {
+        std::string const expected = integral2str(values[i]).data();
+        if(offsets[i] > offsets[i + 1] || offsets[i + 1] > n * longest ||
+           std::string(&out[offsets[i]], &out[offsets[i + 1]]) != expected)
+        {
+            std::cout << "  " << expected << " at " << i << " of " << n << '\n';
+            same = false;
+        }
+    }
+    return same;
+}
+
+// 0, 9, 10, 10^k - 1, 10^k and 10^k + 1 for every 10^k that T holds,
+// the limits of T, and the negatives of all of them; then random
+// values of every length.
+template<class T>
+std::vector<T> test_values()
+{
+    std::vector<T> values;
+    values.push_back(T(0));
+    values.push_back(T(9));
+    values.push_back(T(10));
+    values.push_back((std::numeric_limits<T>::min)());
+    values.push_back((std::numeric_limits<T>::max)());
+
+    widest p = 10;
+    for(int k = 1; k <= std::numeric_limits<T>::digits10; ++k, p *= 10)
+    {
+        values.push_back(T(p - 1));
+        values.push_back(T(p));
+        values.push_back(T(p + 1));
+    }
+
+    std::size_t const special = values.size();
+    if(std::numeric_limits<T>::is_signed)
+        for(std::size_t i = 1; i < special; ++i)
+            if(values[i] != (std::numeric_limits<T>::min)())
+                values.push_back(T(-values[i]));
+
+    boost::uint64_t seed = 31415;
+    for(int i = 0; i < 1001; ++i)
+    {
+        T const v = random_value<T>(seed);
+        values.push_back(v);
+        // a neighbour of the same length, so both lanes of the AVX2
+        // pair loop see the same side of the 16-digit split
+        if(i % 7 == 0)
+            values.push_back(T(v ^ 1));
+    }
+    return values;
+}
+
+template<class T>
+void test_type()
+{
+    std::vector<T> const values = test_values<T>();
+    // odd and even counts, so the pair loop ends with and without
+    // a single value left
+    for(std::size_t n = 0; n <= 5; ++n)
+        CHECK(same_as_integral2str(values, n));
+    CHECK(same_as_integral2str(values, values.size()));
+    CHECK(same_as_integral2str(values, values.size() - 1));
+
+    // every value in either lane of a pair, and then alone
+    for(std::size_t i = 0; i + 1 < values.size(); ++i)
+    {
+        std::vector<T> three(values.begin() + i, values.begin() + i + 2);
+        three.push_back(values[i]);
+        CHECK(same_as_integral2str(three, 3));
+    }
+}
+
+int main()
+{
+    test_type<int>();
+    test_type<unsigned int>();
+    test_type<long>();
+    test_type<unsigned long>();
+#if defined(BOOST_HAS_LONG_LONG)
+    test_type<long long>();
+    test_type<unsigned long long>();
+#endif
+#if defined(BOOST_HAS_INT128)
+    test_type<__int128>();
+    test_type<unsigned __int128>();
+#endif
+    return test_result();
+}
+
+/*
+ * Distributed under the Boost Software License, Version 1.0. (See
+ * accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
@@ -0,0 +1,123 @@
+// Times the digit counting strategies of integral2str.hpp: the
+// comparison chains digits_3 and digits_5 against the leading zero
+// count of digits_10, alone and as used by unsigned2str_5, on
+// uniform values and on values skewed towards few digits (ids,
+// counters and prices are mostly short). The result decides
+// digits_use_nlz in integral2str.hpp.
+//
+// g++ -O2 -I $BOOST_ROOT integral2str_digits_bench.cpp
+//	a.out          # ns per value for digits_3, digits_5 and digits_10
+//	               # side by side, then the digits_use_nlz in effect
+//	a.out 50       # 50 passes per timing instead of 200
+
+#define BOOST_CHRONO_HEADER_ONLY
+#include "integral2str.hpp"
+#include <boost/chrono.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+typedef boost::chrono::steady_clock Clock;
+
+// Deterministic values, so runs are comparable.
+struct Random
+{
+    explicit Random(boost::uint32_t seed_)
+      : seed(seed_)
+    {}
+
+    boost::uint32_t operator()()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 4;
+    }
+
+    boost::uint32_t seed;
+};
+
+// Uniform in [0, limit), or with skewed set, uniform in the number
+// of bits, which makes one and two digit values the most common.
+template<class T>
+std::vector<T> make_values(boost::uint32_t limit, bool skewed)
+{
+    Random rnd(limit);
+    std::vector<T> values(1 << 16);
+    for(std::size_t i = 0; i < values.size(); ++i)
+    {
+        boost::uint32_t v = rnd() % limit;
+        if(skewed)
+            v >>= rnd() % 17;
+        values[i] = T(v);
+    }
+    return values;
+}
+
+struct count_3  { template<class T> int operator()(T un) const { return digits_3(un); } };
+struct count_5  { template<class T> int operator()(T un) const { return digits_5(un); } };
+struct count_10 { template<class T> int operator()(T un) const { return digits_10(un); } };
+
+// Count only.
+template<class Count, class T>
+double time_count(std::vector<T> const& values, int passes, long& sink)
+{
+    Count count;
+    Clock::time_point start = Clock::now();
+    for(int p = 0; p < passes; ++p)
+        for(std::size_t i = 0; i < values.size(); ++i)
+            sink += count(values[i]);
+    double s = boost::chrono::duration<double>(Clock::now() - start).count();
+    return s * 1e9 / (double(passes) * values.size());
+}
+
+// Count and write, as integral2str_switch<5> does.
+template<class Count, class T>
+double time_write(std::vector<T> const& values, int passes, long& sink)
+{
+    Count count;
+    char buf[8];
+    Clock::time_point start = Clock::now();
+    for(int p = 0; p < passes; ++p)
+        for(std::size_t i = 0; i < values.size(); ++i)
+            sink += unsigned2str_5(values[i], buf, count(values[i])) - buf + buf[0];
+    double s = boost::chrono::duration<double>(Clock::now() - start).count();
+    return s * 1e9 / (double(passes) * values.size());
+}
+
+template<class T>
+void bench(char const* type, boost::uint32_t limit, bool with_3, int passes)
+{
+    long sink = 0;
+    for(int skewed = 0; skewed < 2; ++skewed)
+    {
+        std::vector<T> values = make_values<T>(limit, skewed != 0);
+        std::printf("%-15s %-8s", type, skewed ? "skewed" : "uniform");
+        if(with_3)
+            std::printf("  digits_3 %5.2f", time_count<count_3>(values, passes, sink));
+        else
+            std::printf("  %14s", "");
+        std::printf("  digits_5 %5.2f  digits_10 %5.2f ns",
+            time_count<count_5>(values, passes, sink),
+            time_count<count_10>(values, passes, sink));
+        std::printf("  |  write: digits_5 %5.2f  digits_10 %5.2f ns\n",
+            time_write<count_5>(values, passes, sink),
+            time_write<count_10>(values, passes, sink));
+    }
+    if(sink == 42)
+        std::printf("\n");
+}
+
+int main(int argc, char* argv[])
+{
+    int passes = argc > 1 ? std::atoi(argv[1]) : 200;
+
+    bench<unsigned char>("unsigned char", 256, true, passes);
+    bench<unsigned short>("unsigned short", 65536, false, passes);
+    bench<unsigned int>("unsigned int", 100000, false, passes);
+
+    std::printf("digits_use_nlz: unsigned char %d, unsigned short %d, unsigned int %d\n",
+        int(digits_use_nlz<unsigned char>::value),
+        int(digits_use_nlz<unsigned short>::value),
+        int(digits_use_nlz<unsigned int>::value));
+    return 0;
+}
+
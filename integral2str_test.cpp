@@ -0,0 +1,114 @@
+// Regression tests for integral2str.hpp.
+//
+// Checks the multiply-shift divisions of the 8-digit chunks over
+// every value they are used on, and integral2str against a plain
+// divide-by-10 loop around the chunk boundaries, the powers of 10
+// and the limits of each type. Prints each failed check and exits
+// non-zero if any failed.
+//
+// g++ -O2 -I $BOOST_ROOT integral2str_test.cpp
+
+#include "integral2str.hpp"
+#include "test_support.hpp"
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// (n * 5243) >> 19 is n / 100 for the n < 10^4 of unsigned2str_4,
+// unsigned2str_1_4 and unsigned2str_5, and (n * 109951163) >> 40 is
+// n / 10000 for the n < 10^8 of unsigned2str_8 and unsigned2str_1_8.
+void test_divisions()
+{
+    int wrong = 0;
+    for(boost::uint32_t n = 0; n < 10000u; ++n)
+        wrong += ((n * 5243u) >> 19) != n / 100u;
+    CHECK(wrong == 0);
+
+    wrong = 0;
+    for(boost::uint32_t n = 0; n < 100000000u; ++n)
+        wrong += (boost::uint32_t)((boost::uint64_t(n) * 109951163u) >> 40) != n / 10000u;
+    CHECK(wrong == 0);
+}
+
+// The digits of un, one division by 10 at a time.
+std::string reference(widest un, bool neg)
+{
+    std::string digits;
+    do
+    {
+        digits.insert(digits.begin(), char('0' + int(un % 10)));
+        un /= 10;
+    }
+    while(un != 0);
+    return neg ? '-' + digits : digits;
+}
+
+template<class T>
+bool same_as_reference(T n)
+{
+    widest const un = n < 0 ? widest(0) - widest(n) : widest(n);
+    std::string const expected = reference(un, n < 0);
+    bool const same = integral2str(n).data() == expected;
+    if(!same)
+        std::cout << "  " << expected << ": got " << integral2str(n).data() << '\n';
+    return same;
+}
+
+// Every value within 2 of a power of 10 or of the type's limits
+// that T holds, and random values of every length.
+template<class T>
+void test_type()
+{
+    T const lo = (std::numeric_limits<T>::min)();
+    T const hi = (std::numeric_limits<T>::max)();
+
+    for(T d = 0; d <= 2; ++d)
+    {
+        CHECK(same_as_reference(T(lo + d)));
+        CHECK(same_as_reference(T(hi - d)));
+        CHECK(same_as_reference(d));
+    }
+
+    widest p = 10;
+    for(int k = 1; k <= std::numeric_limits<T>::digits10; ++k, p *= 10)
+    {
+        for(int d = -2; d <= 2; ++d)
+        {
+            T const n = T(p + d);
+            CHECK(same_as_reference(n));
+            if(std::numeric_limits<T>::is_signed)
+                CHECK(same_as_reference(T(-n)));
+        }
+    }
+
+    boost::uint64_t seed = 2718;
+    for(int i = 0; i < 100000; ++i)
+    {
+        CHECK(same_as_reference(random_value<T>(seed)));
+    }
+}
+
+int main()
+{
+    test_divisions();
+    test_type<int>();
+    test_type<unsigned int>();
+    test_type<long>();
+    test_type<unsigned long>();
+#if defined(BOOST_HAS_LONG_LONG)
+    test_type<long long>();
+    test_type<unsigned long long>();
+#endif
+#if defined(BOOST_HAS_INT128)
+    test_type<__int128>();
+    test_type<unsigned __int128>();
+#endif
+    return test_result();
+}
+
+/*
+ * Distributed under the Boost Software License, Version 1.0. (See
+ * accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
@@ -2,6 +2,8 @@
 //  Prototype a way to eliminate all dynamic dispatching in grammar.
 //  IOW, instead of having rule<...> have some way to create a type
 //  the represents a specific grammar.
+//  Finished, for character input and with semantic actions, as
+//  static_grammar.hpp in price_parsing.7z.
 #include <boost/mpl/integral_c.hpp>
 #include <boost/mpl/map.hpp>
 #include <iostream>
@@ -0,0 +1,153 @@
+// Decimal strings to integers, the inverse of integral2str.
+//
+// str2integral<T>(first, last) parses an optional '-' (signed T
+// only) followed by decimal digits from [first, last). It skips no
+// whitespace, accepts no '+' and looks at no locale or errno:
+//
+//   str2integral_result<int> r = str2integral<int>(s, s + len);
+//   if(r.error == str2integral_ok) use(r.value); // r.end after the digits
+//
+// With str2integral_no_digits, value is 0 and end is first. With
+// str2integral_overflow, value is the max or min of T and end is
+// still after all the digits, as with strtol.
+#ifndef FILE_str2integral_hpp_INCLUDED_R3V8N1TQ5
+#define FILE_str2integral_hpp_INCLUDED_R3V8N1TQ5
+
+#include <boost/cstdint.hpp>
+#include <boost/predef/other/endian.h>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/make_unsigned.hpp>
+#include <cstring>
+#include <limits>
+
+enum str2integral_errc
+{
+    str2integral_ok,
+    str2integral_no_digits,
+    str2integral_overflow
+};
+
+template<class T>
+struct str2integral_result
+{
+    T value;
+    char const* end;
+    str2integral_errc error;
+};
+
+inline unsigned digit_of(char c) // > 9 if c isn't a digit
+{
+    return (unsigned char)c - unsigned('0');
+}
+
+#if BOOST_ENDIAN_LITTLE_BYTE
+#  define STR2INTEGRAL_SWAR
+
+// True if all 8 characters in v, first in the low byte, are digits:
+// the high nibble of each byte is 3, and adding 6 to the low one
+// doesn't carry into it.
+inline bool all_digits_8(boost::uint64_t v)
+{
+    return ((v & 0xf0f0f0f0f0f0f0f0ull) |
+            (((v + 0x0606060606060606ull) & 0xf0f0f0f0f0f0f0f0ull) >> 4))
+           == 0x3333333333333333ull;
+}
+
+// The value of 8 digits in v, first in the low byte. Each step
+// merges neighbours, 2 digits per 16-bit lane, then 4 per 32-bit
+// lane, then all 8.
+inline boost::uint32_t digits8_value(boost::uint64_t v)
+{
+    v -= 0x3030303030303030ull;
+    v = (v * 10 + (v >> 8)) & 0x00ff00ff00ff00ffull;
+    v = (v * 100 + (v >> 16)) & 0x0000ffff0000ffffull;
+    v = (v * 10000 + (v >> 32)) & 0x00000000ffffffffull;
+    return (boost::uint32_t)v;
+}
+#endif
+
+template<class T>
+inline str2integral_result<T> str2integral(char const* first, char const* last)
+{
+    BOOST_STATIC_ASSERT(std::numeric_limits<T>::is_integer);
+
+    typedef typename boost::make_unsigned<T>::type U;
+
+    // Any Digits10 digits fit in T, and the number has at most one
+    // more, so only that one is checked. lim and lim_digit are
+    // constants; the max of every signed T ends in 7, so the min's
+    // last digit is lim_digit + 1 without a carry.
+    int const Digits10 = std::numeric_limits<T>::digits10;
+    U const max = U(std::numeric_limits<T>::max());
+    U const lim = max / 10u;
+    unsigned const lim_digit = unsigned(max % 10u);
+
+    str2integral_result<T> result = { T(0), first, str2integral_no_digits };
+
+    char const* p = first;
+    bool const neg = std::numeric_limits<T>::is_signed && p != last && *p == '-';
+    p += neg;
+
+    if(p == last || digit_of(*p) > 9)
+        return result;
+
+    // Leading zeros would count against Digits10.
+    while(p != last && *p == '0')
+        ++p;
+
+    char const* const digits = p;
+    U un = 0;
+
+#if defined(STR2INTEGRAL_SWAR)
+    if(Digits10 >= 8)
+    {
+        while(last - p >= 8 && p - digits + 8 <= Digits10)
+        {
+            boost::uint64_t v;
+            std::memcpy(&v, p, 8);
+            if(!all_digits_8(v))
+                break;
+            un = U(un * 100000000u + digits8_value(v));
+            p += 8;
+        }
+    }
+#endif
+
+    for(; p != last && p - digits < Digits10; ++p)
+    {
+        unsigned d = digit_of(*p);
+        if(d > 9)
+            break;
+        un = U(un * 10u + d);
+    }
+
+    result.end = p;
+    result.error = str2integral_ok;
+
+    if(p != last && digit_of(*p) <= 9)
+    {
+        unsigned d = digit_of(*p);
+        if(un < lim || (un == lim && d <= lim_digit + neg))
+        {
+            un = U(un * 10u + d);
+            ++p;
+        }
+        result.end = p;
+
+        if(p != last && digit_of(*p) <= 9)
+        {
+            while(p != last && digit_of(*p) <= 9)
+                ++p;
+            result.end = p;
+            result.value = neg ? std::numeric_limits<T>::min()
+                               : std::numeric_limits<T>::max();
+            result.error = str2integral_overflow;
+            return result;
+        }
+    }
+
+    result.value = neg ? T(U(0u - un)) : T(un);
+    return result;
+}
+
+#endif // #ifndef FILE_str2integral_hpp_INCLUDED_R3V8N1TQ5
@@ -0,0 +1,223 @@
+// Regression tests for str2integral.hpp.
+//
+// Checks str2integral against a digit-string comparison with the
+// limits of each type: at and beyond the limits, without digits,
+// stopping at a non-digit, and at the lengths around the 8-digit
+// steps of the SWAR path; and that integral2str's output of random
+// values reads back. For long long, strtoll has to agree as well.
+// Prints each failed check and exits non-zero if any failed.
+//
+// g++ -O2 -I $BOOST_ROOT str2integral_test.cpp
+
+#include "str2integral.hpp"
+#include "integral2str.hpp"
+#include "test_support.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// integral2str's digits of n, without the '-'.
+template<class T>
+std::string magnitude(T n)
+{
+    typename resultof_integral2str<T>::type const str = integral2str(n);
+    return std::string(str.data() + (str[0] == '-'));
+}
+
+// Adds 1 to the decimal number digits.
+std::string plus_one(std::string digits)
+{
+    std::string::size_type i = digits.size();
+    while(i > 0 && digits[i - 1] == '9')
+        digits[--i] = '0';
+    if(i == 0)
+        return '1' + digits;
+    ++digits[i - 1];
+    return digits;
+}
+
+// What str2integral<T> has to return for [first, last): the digits
+// are compared as strings with those of T's limit.
+template<class T>
+str2integral_result<T> expected(char const* first, char const* last)
+{
+    str2integral_result<T> result = { T(0), first, str2integral_no_digits };
+
+    char const* p = first;
+    bool const neg = std::numeric_limits<T>::is_signed && p != last && *p == '-';
+    p += neg;
+    char const* const digits = p;
+    while(p != last && '0' <= *p && *p <= '9')
+        ++p;
+    if(p == digits)
+        return result;
+
+    std::string s(digits, p);
+    s.erase(0, std::min(s.find_first_not_of('0'), s.size() - 1));
+
+    T const limit = neg ? (std::numeric_limits<T>::min)() : (std::numeric_limits<T>::max)();
+    std::string const lim = magnitude(limit);
+
+    result.end = p;
+    if(s.size() > lim.size() || (s.size() == lim.size() && s > lim))
+    {
+        result.value = limit;
+        result.error = str2integral_overflow;
+        return result;
+    }
+
+    widest un = 0;
+    for(std::string::size_type i = 0; i < s.size(); ++i)
+        un = un * 10 + (s[i] - '0');
+    result.value = neg ? T(widest(0) - un) : T(un);
+    result.error = str2integral_ok;
+    return result;
+}
+
+// For long long, strtoll has to agree too; the inputs have no
+// leading whitespace or '+' for it to skip.
+template<class T>
+bool same_as_strtoll(str2integral_result<T> const&, char const*)
+{
+    return true;
+}
+
+#if defined(BOOST_HAS_LONG_LONG)
+bool same_as_strtoll(str2integral_result<long long> const& r, char const* first)
+{
+    char* end;
+    errno = 0;
+    long long const value = std::strtoll(first, &end, 10);
+    return value == r.value && end == r.end &&
+           (errno == ERANGE) == (r.error == str2integral_overflow);
+}
+#endif
+
+template<class T>
+bool same_as_expected(std::string const& str)
+{
+    char const* const first = str.data();
+    char const* const last = first + str.size();
+    str2integral_result<T> const r = str2integral<T>(first, last);
+    str2integral_result<T> const e = expected<T>(first, last);
+    bool const same = r.value == e.value && r.end == e.end && r.error == e.error &&
+                      same_as_strtoll(r, first);
+    if(!same)
+        std::cout << "  \"" << str << "\": got " << integral2str(r.value).data()
+                  << " ending at " << r.end - first << " with error " << r.error
+                  << ", not " << integral2str(e.value).data()
+                  << " ending at " << e.end - first << " with error " << e.error << '\n';
+    return same;
+}
+
+template<class T>
+void test_type()
+{
+    T const lo = (std::numeric_limits<T>::min)();
+    T const hi = (std::numeric_limits<T>::max)();
+    std::string const min = integral2str(lo).data();
+    std::string const max = integral2str(hi).data();
+
+    // the limits and one beyond them, also with a non-digit after
+    str2integral_result<T> r = str2integral<T>(max.data(), max.data() + max.size());
+    CHECK(r.value == hi && r.error == str2integral_ok && r.end == max.data() + max.size());
+    r = str2integral<T>(min.data(), min.data() + min.size());
+    CHECK(r.value == lo && r.error == str2integral_ok && r.end == min.data() + min.size());
+
+    std::string const above = plus_one(max);
+    r = str2integral<T>(above.data(), above.data() + above.size());
+    CHECK(r.value == hi && r.error == str2integral_overflow && r.end == above.data() + above.size());
+    CHECK(same_as_expected<T>(above + "x"));
+    CHECK(same_as_expected<T>(above + "0"));
+    CHECK(same_as_expected<T>("000" + max));
+    if(std::numeric_limits<T>::is_signed)
+    {
+        std::string const below = '-' + plus_one(magnitude(lo));
+        r = str2integral<T>(below.data(), below.data() + below.size());
+        CHECK(r.value == lo && r.error == str2integral_overflow && r.end == below.data() + below.size());
+        CHECK(same_as_expected<T>(below + "-"));
+        CHECK(same_as_expected<T>("-000" + magnitude(lo)));
+    }
+
+    // no digits: the end is first, a '-' alone included
+    char const* const none[] = { "", "-", "--1", "+1", " 1", "x", "-x" };
+    for(std::size_t i = 0; i < sizeof(none) / sizeof(*none); ++i)
+    {
+        char const* first = none[i];
+        r = str2integral<T>(first, first + std::strlen(first));
+        CHECK(r.value == 0 && r.end == first && r.error == str2integral_no_digits);
+    }
+    r = str2integral<T>("-1", "-1" + 2);
+    CHECK(std::numeric_limits<T>::is_signed ? r.value == T(-1) && r.error == str2integral_ok
+                                            : r.error == str2integral_no_digits);
+
+    // lengths around the 8-digit steps, stopped by a non-digit at
+    // every place and by last
+    int const lengths[] = { 1, 7, 8, 9, 15, 16, 17, 24,
+                            std::numeric_limits<T>::digits10,
+                            std::numeric_limits<T>::digits10 + 1,
+                            std::numeric_limits<T>::digits10 + 2 };
+    boost::uint64_t seed = 1618;
+    for(std::size_t i = 0; i < sizeof(lengths) / sizeof(*lengths); ++i)
+    {
+        for(int kind = 0; kind < 4; ++kind)
+        {
+            std::string digits;
+            for(int j = 0; j < lengths[i]; ++j)
+            {
+                char const random = char('0' + int(next_random(seed) >> 60) % 10);
+                char const fixed[] = { '9', j == 0 ? '1' : '0', j == 0 ? '0' : random, random };
+                digits += fixed[kind];
+            }
+            for(std::size_t stop = 0; stop <= digits.size(); ++stop)
+            {
+                std::string str = digits;
+                if(stop < str.size())
+                    str[stop] = stop % 2 ? ':' : '/'; // just past '9', just before '0'
+                CHECK(same_as_expected<T>(str));
+                CHECK(same_as_expected<T>(str.substr(0, stop)));
+                CHECK(same_as_expected<T>('-' + str));
+            }
+        }
+    }
+
+    // random values of every length read back from integral2str
+    for(int i = 0; i < 100000; ++i)
+    {
+        T const v = random_value<T>(seed);
+        typename resultof_integral2str<T>::type const str = integral2str(v);
+        char const* const end = str.data() + std::strlen(str.data());
+        r = str2integral<T>(str.data(), end);
+        CHECK(r.value == v && r.end == end && r.error == str2integral_ok);
+    }
+}
+
+int main()
+{
+    test_type<signed char>();
+    test_type<unsigned char>();
+    test_type<short>();
+    test_type<unsigned short>();
+    test_type<int>();
+    test_type<unsigned int>();
+    test_type<long>();
+    test_type<unsigned long>();
+#if defined(BOOST_HAS_LONG_LONG)
+    test_type<long long>();
+    test_type<unsigned long long>();
+#endif
+#if defined(BOOST_HAS_INT128)
+    test_type<__int128>();
+    test_type<unsigned __int128>();
+#endif
+    return test_result();
+}
+
+/*
+ * Distributed under the Boost Software License, Version 1.0. (See
+ * accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
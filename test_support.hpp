@@ -0,0 +1,56 @@
+// What the *_test.cpp programs share: CHECK, which prints a failed
+// check and counts it, the exit code main() returns, and
+// deterministic random values, so failures can be reproduced.
+//
+// Each test is a program of one translation unit, so failures is
+// defined here.
+#ifndef FILE_test_support_hpp_INCLUDED_M4T7K2WQ8
+#define FILE_test_support_hpp_INCLUDED_M4T7K2WQ8
+
+#include <boost/cstdint.hpp>
+#include <iostream>
+#include <limits>
+
+int failures = 0;
+
+#define CHECK(expr)                                                         \
+    if(!(expr))                                                             \
+    {                                                                       \
+        std::cout << __FILE__ << '(' << __LINE__ << "): "                   \
+                  << "check failed: " #expr << '\n';                        \
+        ++failures;                                                         \
+    }
+
+// Prints whether every check passed; main() returns this.
+inline int test_result()
+{
+    std::cout << (failures ? "FAILED" : "passed") << '\n';
+    return failures != 0;
+}
+
+// The widest unsigned type integral2str and str2integral handle.
+#if defined(BOOST_HAS_INT128)
+typedef unsigned __int128 widest;
+#else
+typedef boost::uint64_t widest;
+#endif
+
+// Steps the 64-bit LCG in seed and returns its new state.
+inline boost::uint64_t next_random(boost::uint64_t& seed)
+{
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    return seed;
+}
+
+// A random T of a random number of bits, 1 to all of T's, so each
+// length is as likely and short values are common.
+template<class T>
+T random_value(boost::uint64_t& seed)
+{
+    widest bits = next_random(seed);
+    bits = (bits << 32 << 32) | next_random(seed);
+    int const keep = int(seed >> 57) % std::numeric_limits<T>::digits + 1;
+    return T(bits >> (sizeof(widest) * 8 - keep));
+}
+
+#endif // #ifndef FILE_test_support_hpp_INCLUDED_M4T7K2WQ8
@@ -0,0 +1,556 @@
+// Throughput benchmark for the matcher in thompson-nfa-perl-regex.cpp.
+//
+// Times the ways the matcher has of running a regex over a corpus.
+// Patterns meant for lines run on each line of the corpus through
+// match() (the NFA, with submatches) in each match and repetition
+// mode, matchspan() in each match mode, and search().  The others
+// run over the whole corpus, from one match to the next, through
+// match() and matchspan(), and through parallel_search() when there
+// is more than one thread to search with (-j, by default one per
+// core).  search() is not timed on the whole corpus: it only says
+// whether there is a match, and stops at the first.  Reports MB/s
+// and calls per second, and the number of hits so that engines that
+// disagree stand out.  With -x and -s the patterns meant for lines
+// also run through boost::xpressive and std::regex, for comparison.
+//
+// Without patterns, a built-in suite runs on generated corpora: the
+// pathological (a?){n}a{n}, capture-heavy, literal-heavy and
+// alternation patterns.  Otherwise the patterns given are run on the
+// file given with -f, or on a generated log-like corpus.
+//
+// g++ -O2 -I $BOOST_ROOT thompson-nfa-perl-regex-bench.cpp -L $BOOST_ROOT/stage/lib -lboost_thread
+//	a.out                         # built-in suite
+//	a.out -x -s                   # ... against xpressive and std::regex
+//	a.out -f access.log 'GET (.*) HTTP' 'x(ab|a)*y'
+//	a.out -j 8 -t 1               # 8 search threads, 1 second per timing
+//	a.out -- '-+x'                # a pattern that begins with -
+//	a.out -h                      # the options
+//
+// Copyright (c) 2011 Eric Niebler.
+// Can be distributed under the Boost Softwate License 1.0, see bottom of file.
+
+#define NFA_PERL_NO_MAIN
+#define BOOST_CHRONO_HEADER_ONLY
+#include "thompson-nfa-perl-regex.cpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <boost/chrono.hpp>
+#include <boost/xpressive/xpressive.hpp>
+#if __cplusplus >= 201103L
+#include <regex>
+#endif
+
+typedef std::string::const_iterator Iter;
+typedef boost::chrono::steady_clock Clock;
+
+// A corpus, and the lines it is cut into for the line-by-line engines.
+struct Corpus
+{
+    Corpus(std::string const &name_, std::string const &text_)
+      : name(name_), text(text_), lines()
+    {
+        std::size_t b = 0;
+        while(b < text.size())
+        {
+            std::size_t e = text.find('\n', b);
+            if(e == std::string::npos)
+                e = text.size();
+            lines.push_back(std::make_pair(b, e));
+            b = e + 1;
+        }
+    }
+
+    std::string name;
+    std::string text;
+    std::vector<std::pair<std::size_t, std::size_t> > lines;
+};
+
+// Generated corpora are the same from run to run: they come from
+// this linear congruential generator, not from std::rand().
+struct Random
+{
+    explicit Random(boost::uint32_t seed_)
+      : seed(seed_)
+    {}
+
+    std::size_t operator()(std::size_t n)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) % n;
+    }
+
+    boost::uint32_t seed;
+};
+
+// Lines of n copies of c.
+std::string repeated(char c, std::size_t n, std::size_t nlines)
+{
+    std::string line(n, c);
+    std::string text;
+    for(std::size_t i = 0; i < nlines; ++i)
+        (text += line) += '\n';
+    return text;
+}
+
+// size bytes of lines of random letters from alphabet.
+std::string random_text(std::size_t size, std::string const &alphabet, std::size_t linelen)
+{
+    Random rnd(size);
+    std::string text;
+    text.reserve(size);
+    while(text.size() < size)
+        text += (text.size() + 1) % (linelen + 1) == 0 ? '\n' : alphabet[rnd(alphabet.size())];
+    return text;
+}
+
+// size bytes of log lines: a timestamp and a few words, with
+// needle on every every'th line.
+std::string log_text(std::size_t size, std::string const &needle, std::size_t every)
+{
+    static char const *const words[] =
+    {
+        "connection", "accepted", "from", "client", "request", "served",
+        "cache", "miss", "hit", "worker", "started", "stopped", "GET",
+        "POST", "/index.html", "HTTP/1.1", "200", "404", "bytes", "in",
+        "ms", "user", "session", "closed", "queue", "depth", "retry"
+    };
+    std::size_t const nwords = sizeof(words) / sizeof(*words);
+
+    Random rnd(every);
+    std::string text;
+    text.reserve(size + 128);
+    for(std::size_t n = 0; text.size() < size; ++n)
+    {
+        char stamp[32];
+        std::sprintf(stamp, "%02d:%02d:%02d.%03d ", int(n / 3600000 % 24),
+            int(n / 60000 % 60), int(n / 1000 % 60), int(n % 1000));
+        text += stamp;
+        for(std::size_t w = 3 + rnd(8); w > 0; --w)
+            (text += words[rnd(nwords)]) += ' ';
+        if(every != 0 && n % every == every - 1)
+            text += needle;
+        text += '\n';
+    }
+    return text;
+}
+
+bool load(char const *path, std::string &text)
+{
+    std::ifstream in(path, std::ios::binary);
+    if(!in)
+        return false;
+    std::ostringstream buf;
+    buf << in.rdbuf();
+    text = buf.str();
+    return true;
+}
+
+// (a?){n}a{n}, spelled out: the grammar has no counted repeats.
+std::string pathological(std::size_t n)
+{
+    std::string re;
+    for(std::size_t i = 0; i < n; ++i)
+        re += "(a?)";
+    return re + std::string(n, 'a');
+}
+
+// How long an engine took over a corpus, and what it found.
+struct Timing
+{
+    double seconds;
+    std::size_t bytes, calls, hits;
+};
+
+double seconds_since(Clock::time_point start)
+{
+    return boost::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Run body, which reports the bytes it covered and the calls
+// it made, until at least mintime has passed.
+template<typename Body>
+Timing time_runs(Body body, double mintime)
+{
+    Timing t = {0, 0, 0, 0};
+    Clock::time_point start = Clock::now();
+    do
+    {
+        t.hits = body(t.bytes, t.calls);
+        t.seconds = seconds_since(start);
+    } while(t.seconds < mintime);
+    return t;
+}
+
+// The engines.  Each is one pass over the corpus; it returns the
+// number of hits and adds up the bytes it read and calls it made.
+
+enum
+{
+    UseMatch,       // the NFA, with submatches
+    UseMatchSpan,   // the DFAs, overall match only
+    UseSearch,      // the forward DFA, match or not
+    UseParallel     // parallel_search
+};
+
+struct match_lines
+{
+    match_lines(Matcher<Iter> &m_, Corpus const &c_, int engine_)
+      : m(m_), c(c_), engine(engine_)
+    {}
+
+    std::size_t operator()(std::size_t &bytes, std::size_t &calls) const
+    {
+        std::size_t hits = 0;
+        for(std::size_t i = 0; i < c.lines.size(); ++i)
+        {
+            Iter b = c.text.begin() + c.lines[i].first;
+            Iter e = c.text.begin() + c.lines[i].second;
+            switch(engine)
+            {
+            case UseMatch:     hits += m.match(b, e); break;
+            case UseMatchSpan: hits += m.matchspan(b, e); break;
+            case UseSearch:    hits += m.search(b, e); break;
+            }
+        }
+        bytes += c.text.size();
+        calls += c.lines.size();
+        return hits;
+    }
+
+    Matcher<Iter> &m;
+    Corpus const &c;
+    int engine;
+};
+
+// Every match in the whole corpus, found one call at a time
+// from the end of the last.
+struct search_all
+{
+    search_all(Matcher<Iter> &m_, Corpus const &c_, int engine_, int nthreads_ = 1)
+      : m(m_), c(c_), engine(engine_), nthreads(nthreads_)
+    {}
+
+    std::size_t operator()(std::size_t &bytes, std::size_t &calls) const
+    {
+        std::size_t hits = 0;
+        Iter icur = c.text.begin(), iend = c.text.end();
+        for(;;)
+        {
+            ++calls;
+            bool found = false;
+            switch(engine)
+            {
+            case UseMatch:     found = m.match(icur, iend); break;
+            case UseMatchSpan: found = m.matchspan(icur, iend); break;
+            case UseParallel:  found = parallel_search(m, icur, iend, nthreads); break;
+            }
+            if(!found)
+                break;
+            ++hits;
+            if(m.subs[0].second == iend)
+                break;
+            // step past empty matches
+            icur = m.subs[0].second == m.subs[0].first
+              ? boost::next(m.subs[0].second)
+              : m.subs[0].second;
+        }
+        bytes += c.text.size();
+        return hits;
+    }
+
+    Matcher<Iter> &m;
+    Corpus const &c;
+    int engine, nthreads;
+};
+
+struct xpressive_lines
+{
+    xpressive_lines(boost::xpressive::sregex const &rx_, Corpus const &c_)
+      : rx(rx_), c(c_)
+    {}
+
+    std::size_t operator()(std::size_t &bytes, std::size_t &calls) const
+    {
+        std::size_t hits = 0;
+        boost::xpressive::smatch what;
+        for(std::size_t i = 0; i < c.lines.size(); ++i)
+        {
+            Iter b = c.text.begin() + c.lines[i].first;
+            Iter e = c.text.begin() + c.lines[i].second;
+            hits += boost::xpressive::regex_search(b, e, what, rx);
+        }
+        bytes += c.text.size();
+        calls += c.lines.size();
+        return hits;
+    }
+
+    boost::xpressive::sregex const &rx;
+    Corpus const &c;
+};
+
+#if __cplusplus >= 201103L
+struct std_regex_lines
+{
+    std_regex_lines(std::regex const &rx_, Corpus const &c_)
+      : rx(rx_), c(c_)
+    {}
+
+    std::size_t operator()(std::size_t &bytes, std::size_t &calls) const
+    {
+        std::size_t hits = 0;
+        std::smatch what;
+        for(std::size_t i = 0; i < c.lines.size(); ++i)
+        {
+            Iter b = c.text.begin() + c.lines[i].first;
+            Iter e = c.text.begin() + c.lines[i].second;
+            hits += std::regex_search(b, e, what, rx);
+        }
+        bytes += c.text.size();
+        calls += c.lines.size();
+        return hits;
+    }
+
+    std::regex const &rx;
+    Corpus const &c;
+};
+#endif
+
+struct Config
+{
+    Config()
+      : mintime(0.25), nthreads(boost::thread::hardware_concurrency())
+      , xpressive(false), stdregex(false)
+    {}
+
+    double mintime;
+    int nthreads;
+    bool xpressive, stdregex;
+};
+
+void report(std::string const &engine, std::string const &mode, Timing const &t)
+{
+    std::printf("  %-16s %-18s %10.2f MB/s %12.0f calls/s %9lu hits\n",
+        engine.c_str(), mode.c_str(),
+        t.bytes / t.seconds / (1024 * 1024), t.calls / t.seconds,
+        (unsigned long)t.hits);
+}
+
+char const *mode_name(MatchOptions const &opts)
+{
+    static char const *const names[] =
+    {
+        "biased/minimal", "longest/minimal", "biased/perl", "longest/perl"
+    };
+    return names[opts.matchtype + 2 * opts.reptype];
+}
+
+// Every engine and mode on one pattern and corpus.  lines says
+// whether the pattern is meant for line-by-line matching; if not,
+// the whole corpus is searched.  compare is false for patterns
+// that backtracking engines would never finish.
+void bench(std::string const &pattern, Corpus const &c, bool lines, Config const &cfg, bool compare = true)
+{
+    std::printf("%s on %s (%lu bytes, %lu lines)\n", pattern.size() > 48
+        ? (pattern.substr(0, 45) + "...").c_str() : pattern.c_str(),
+        c.name.c_str(), (unsigned long)c.text.size(), (unsigned long)c.lines.size());
+
+    boost::shared_ptr<Regex const> re = Regex::compile(pattern.c_str());
+    if(!re)
+    {
+        std::printf("  invalid regex\n");
+        return;
+    }
+
+    Matcher<Iter> m(*re);
+    for(int mode = 0; mode < 4; ++mode)
+    {
+        m.opts = MatchOptions(mode % 2, mode / 2);
+        if(lines)
+            report("match", mode_name(m.opts), time_runs(match_lines(m, c, UseMatch), cfg.mintime));
+        else
+            report("match", mode_name(m.opts), time_runs(search_all(m, c, UseMatch), cfg.mintime));
+    }
+
+    // the DFAs do not care how repetitions are run
+    for(int mode = 0; mode < 2; ++mode)
+    {
+        m.opts = MatchOptions(mode);
+        if(lines)
+            report("matchspan", mode_name(m.opts), time_runs(match_lines(m, c, UseMatchSpan), cfg.mintime));
+        else
+            report("matchspan", mode_name(m.opts), time_runs(search_all(m, c, UseMatchSpan), cfg.mintime));
+    }
+    if(lines)
+        report("search", "-", time_runs(match_lines(m, c, UseSearch), cfg.mintime));
+
+    if(!lines && cfg.nthreads > 1)
+    {
+        std::ostringstream name;
+        name << "parallel x" << cfg.nthreads;
+        for(int mode = 0; mode < 4; ++mode)
+        {
+            m.opts = MatchOptions(mode % 2, mode / 2);
+            report(name.str(), mode_name(m.opts), time_runs(search_all(m, c, UseParallel, cfg.nthreads), cfg.mintime));
+        }
+    }
+
+    if(!compare && (cfg.xpressive || cfg.stdregex))
+        std::printf("  backtracking engines skipped\n");
+    if(lines && compare && cfg.xpressive)
+    {
+        try
+        {
+            boost::xpressive::sregex rx = boost::xpressive::sregex::compile(pattern);
+            report("xpressive", "perl", time_runs(xpressive_lines(rx, c), cfg.mintime));
+        }
+        catch(boost::xpressive::regex_error const &e)
+        {
+            std::printf("  xpressive: %s\n", e.what());
+        }
+    }
+
+#if __cplusplus >= 201103L
+    if(lines && compare && cfg.stdregex)
+    {
+        try
+        {
+            std::regex rx(pattern);
+            report("std::regex", "ecmascript", time_runs(std_regex_lines(rx, c), cfg.mintime));
+        }
+        catch(std::regex_error const &e)
+        {
+            std::printf("  std::regex: %s\n", e.what());
+        }
+    }
+#endif
+}
+
+void builtin_suite(Config const &cfg)
+{
+    // exponential for backtracking, linear for the NFA
+    for(std::size_t n = 8; n <= 32; n *= 2)
+    {
+        std::ostringstream name;
+        name << n << " a's per line";
+        bench(pathological(n), Corpus(name.str(), repeated('a', n, 4096)), true, cfg, n <= 16);
+    }
+
+    Corpus letters("random abcxyz", random_text(4 << 20, "abcxyz", 79));
+    bench("(a|b)(c|x)((y+)|(z*))(a)(b)?(c)", letters, true, cfg);
+    bench("((a|b)+)(x(y|z)+)((ab|ba)*)", letters, true, cfg);
+
+    Corpus log("log lines", log_text(16 << 20, "ERROR disk full on /var", 5000));
+    bench("ERROR disk full", log, false, cfg);
+    bench("session closed (.*) ms", log, true, cfg);
+    bench("(connection|request|worker|session|queue) (accepted|served|started|closed)", log, true, cfg);
+    bench("(ERROR|WARN|FATAL|PANIC) (disk|network|memory)", log, false, cfg);
+}
+
+void usage(char const *argv0)
+{
+    std::cerr << "USAGE: " << argv0 << " [-f file] [-j threads] [-t seconds] [-x] [-s] [--] [regexp...]\n";
+    std::cerr << "       -f  run the patterns, at least one, on file instead of a generated corpus\n";
+    std::cerr << "       -j  threads for parallel_search\n";
+    std::cerr << "       -t  minimum seconds per timing\n";
+    std::cerr << "       -x  compare with boost::xpressive\n";
+    std::cerr << "       -s  compare with std::regex\n";
+    std::cerr << "       without patterns, runs the built-in suite\n";
+}
+
+int main(int argc, char *argv[])
+{
+    Config cfg;
+    char const *path = 0;
+    for(;;)
+    {
+        if(argc > 2 && std::strcmp(argv[1], "-f") == 0)
+        {
+            path = argv[2];
+            argv[2] = argv[0]; argc -= 2; argv += 2;
+        }
+        else if(argc > 2 && std::strcmp(argv[1], "-j") == 0)
+        {
+            cfg.nthreads = std::atoi(argv[2]);
+            argv[2] = argv[0]; argc -= 2; argv += 2;
+        }
+        else if(argc > 2 && std::strcmp(argv[1], "-t") == 0)
+        {
+            cfg.mintime = std::atof(argv[2]);
+            argv[2] = argv[0]; argc -= 2; argv += 2;
+        }
+        else if(argc > 1 && std::strcmp(argv[1], "-x") == 0)
+        {
+            cfg.xpressive = true;
+            argv[1] = argv[0]; argc--; argv++;
+        }
+        else if(argc > 1 && std::strcmp(argv[1], "-s") == 0)
+        {
+#if __cplusplus >= 201103L
+            cfg.stdregex = true;
+#else
+            std::cerr << "-s ignored: std::regex needs C++11\n";
+#endif
+            argv[1] = argv[0]; argc--; argv++;
+        }
+        else if(argc > 1 && (std::strcmp(argv[1], "-h") == 0 || std::strcmp(argv[1], "--help") == 0))
+        {
+            usage(argv[0]);
+            return 0;
+        }
+        else if(argc > 1 && std::strcmp(argv[1], "--") == 0)
+        {
+            // the patterns follow, even ones that begin with -
+            argv[1] = argv[0]; argc--; argv++;
+            break;
+        }
+        else if(argc > 1 && argv[1][0] == '-' && argv[1][1] != '\0')
+        {
+            if(std::strcmp(argv[1], "-f") == 0 || std::strcmp(argv[1], "-j") == 0 || std::strcmp(argv[1], "-t") == 0)
+                std::cerr << "ERROR: " << argv[1] << " needs a value\n";
+            else
+                std::cerr << "ERROR: unknown option " << argv[1] << '\n';
+            usage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if(argc < 2 && path != 0)
+    {
+        std::cerr << "ERROR: -f needs at least one pattern\n";
+        usage(argv[0]);
+        return 1;
+    }
+    if(argc < 2)
+    {
+        builtin_suite(cfg);
+        return 0;
+    }
+
+    std::string text;
+    if(path != 0 && !load(path, text))
+    {
+        std::cerr << "ERROR: cannot read " << path << '\n';
+        return 1;
+    }
+    Corpus c(path ? path : "log lines", path ? text : log_text(16 << 20, "ERROR disk full on /var", 5000));
+    for(int i = 1; i < argc; ++i)
+    {
+        bench(argv[i], c, true, cfg);
+        bench(argv[i], c, false, cfg);
+    }
+    return 0;
+}
+
+/*
+ * Distributed under the Boost Software License, Version 1.0. (See
+ * accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
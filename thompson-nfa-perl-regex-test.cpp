@@ -0,0 +1,422 @@
+// Regression tests for the matcher in thompson-nfa-perl-regex.cpp.
+//
+// Checks the DFA paths against the capture-tracking NFA, which is
+// the reference, and the corner cases that have gone wrong before.
+// Prints each failed check and exits non-zero if any failed.
+//
+// g++ -O2 -I $BOOST_ROOT thompson-nfa-perl-regex-test.cpp -L $BOOST_ROOT/stage/lib -lboost_thread
+//
+// Copyright (c) 2011 Eric Niebler.
+// Can be distributed under the Boost Softwate License 1.0, see bottom of file.
+
+#define NFA_PERL_NO_MAIN
+#include "thompson-nfa-perl-regex.cpp"
+#include "test_support.hpp"
+
+#include <sstream>
+
+typedef std::string::const_iterator Iter;
+
+// The overall match m last found, as "(first,second)" or "-".
+std::string span(Matcher<Iter> const &m, bool matched)
+{
+    if(!matched)
+        return "-";
+    std::ostringstream out;
+    out << '(' << std::distance(m.begin, m.subs[0].first)
+        << ',' << std::distance(m.begin, m.subs[0].second) << ')';
+    return out.str();
+}
+
+// matchspan() with the lazy DFA, even for programs that fit the
+// bit-parallel simulation.
+bool lazyspan(Matcher<Iter> &m, Iter icur, Iter iend)
+{
+    m.begin = icur; m.end = iend;
+    m.subs.assign(m.nsub, Sub<Iter>());
+    return m.matchspan(m.fwd, m.fwdanchored, m.rev, m.revanchored);
+}
+
+// matchspan() has to find the match match() finds, on either path.
+void test_matchspan()
+{
+    char const *patterns[] = {
+        "abcd|c", "c|abcd", "b*c", "(a|ab)(c|bcd)", "x*", "a.*b", "ab|b.*d", "(ab)*"
+    };
+    char const *texts[] = {
+        "abcd", "xxabcdyy", "c", "", "abababcd", "zzzz", "ab ab b cd", "aabbcc"
+    };
+    int matchtypes[] = { LeftmostBiased, LeftmostLongest };
+
+    for(std::size_t p = 0; p < sizeof(patterns) / sizeof(*patterns); ++p)
+    {
+        boost::shared_ptr<Regex const> re = Regex::compile(patterns[p]);
+        CHECK(re);
+        if(!re)
+            continue;
+        Matcher<Iter> m(*re);
+        for(std::size_t t = 0; t < sizeof(texts) / sizeof(*texts); ++t)
+        {
+            std::string text(texts[t]);
+            for(std::size_t k = 0; k < 2; ++k)
+            {
+                MatchOptions opts(matchtypes[k]);
+                std::string expected = span(m, m.match(text.begin(), text.end(), opts));
+                std::string actual = span(m, m.matchspan(text.begin(), text.end(), opts));
+                m.opts = opts;
+                std::string lazy = span(m, lazyspan(m, text.begin(), text.end()));
+                m.opts = re->opts;
+                if(actual != expected || lazy != expected)
+                {
+                    std::cout << patterns[p] << " on \"" << text << "\": match " << expected
+                              << ", matchspan " << actual << ", lazy " << lazy << '\n';
+                    ++failures;
+                }
+            }
+        }
+    }
+}
+
+// Options given to one call are not kept for the next.
+void test_options()
+{
+    boost::shared_ptr<Regex const> re = Regex::compile("a|ab");
+    CHECK(re);
+    Matcher<Iter> m(*re);
+    std::string text("ab");
+    CHECK(span(m, m.match(text.begin(), text.end(), MatchOptions(LeftmostLongest))) == "(0,2)");
+    CHECK(span(m, m.match(text.begin(), text.end())) == "(0,1)");
+    CHECK(span(m, m.matchspan(text.begin(), text.end(), MatchOptions(LeftmostLongest))) == "(0,2)");
+    CHECK(span(m, m.matchspan(text.begin(), text.end())) == "(0,1)");
+    CHECK(m.opts.matchtype == re->opts.matchtype);
+}
+
+// A cache too small for the states a scan needs is flushed, and
+// the scan goes on with the start state back in place.
+void test_flush()
+{
+    boost::shared_ptr<Regex const> re = Regex::compile("needle(1|2|3|4)+x");
+    CHECK(re);
+    std::string text;
+    for(int i = 0; i < 200; ++i)
+        text += "hay needle12 hay needle3";
+    text += " needle42x";
+
+    LazyDFA dfa(re->fwdprog, false, 16 * 1024);
+    DState *d = dfa.start();
+    Iter icur = text.begin();
+    for(; !dfa.matched(d) && icur != text.end(); ++icur)
+        d = dfa.next(d, *icur & 0xFF);
+    CHECK(dfa.matched(d));
+    CHECK(icur == text.end());
+    CHECK(dfa.flushes > 1);
+    CHECK(dfa.startstate != 0);
+    CHECK(dfa.used <= dfa.budget);
+}
+
+// Patterns that fail to parse leave nothing behind in a RegexSet,
+// whether they fail part way or have text left over.
+void test_regexset()
+{
+    RegexSet set;
+    CHECK(set.add("abc") == 0);
+    CHECK(set.add("(b|a**)") == -1);
+    CHECK(set.add("x(y|w)z") == 1);
+    CHECK(set.add("(a|b**)") == -1);
+    CHECK(set.add("(b?|(a|c)*?*(a))") == -1);
+    CHECK(set.add("ab)") == -1);
+    CHECK(set.add("q+") == 2);
+    set.compile();
+    CHECK(set.size() == 3);
+
+    SetMatcher<Iter> m(set);
+    std::vector<bool> matched;
+    std::string text("--abc--xwz--");
+    CHECK(m.match(text.begin(), text.end(), matched));
+    CHECK(matched.size() == 3 && matched[0] && matched[1] && !matched[2]);
+    text = "ab) b";
+    CHECK(!m.match(text.begin(), text.end(), matched));
+
+    // the required literal is looked for during the scan
+    RegexSet one;
+    CHECK(one.add("(a|b)+needle") == 0);
+    one.compile();
+    CHECK(one.impl.required == "needle");
+    SetMatcher<Iter> m1(one);
+    text = "aaa needl bneedle";
+    CHECK(m1.match(text.begin(), text.end(), matched));
+    CHECK(matched.size() == 1 && matched[0]);
+    text = "aaa needl bneedl";
+    CHECK(!m1.match(text.begin(), text.end(), matched));
+}
+
+// The submatches m last found, as "(first,second)..." or "-".
+std::string spans(Matcher<Iter> const &m, bool matched)
+{
+    if(!matched)
+        return "-";
+    std::ostringstream out;
+    for(std::size_t i = 0; i < m.nsub; ++i)
+    {
+        if(m.subs[i].matched == Matched)
+            out << '(' << std::distance(m.begin, m.subs[i].first)
+                << ',' << std::distance(m.begin, m.subs[i].second) << ')';
+        else
+            out << "(?,?)";
+    }
+    return out.str();
+}
+
+// parallel_search() has to find what match() finds, also when the
+// match begins in one chunk and ends in a later one, and when a
+// chunk's scan gives up before its threads die.
+void test_parallel_search()
+{
+    std::size_t const chunk = MinSearchChunk;
+    struct
+    {
+        char const *pattern;
+        char const *text;
+        std::size_t at;
+        char const *tail;
+    } const cases[] = {
+        { "xxy", "xxy", chunk - 1, "" },
+        { "xxy", "xxy", 3 * chunk - 2, "" },
+        { "xxy", "", 0, "" },
+        { "needle(1|2)+x", "needle1212x", 2 * chunk - 4, "" },
+        { "a(b*)c", "abbbbbbbbc", chunk - 1, "" },
+        { "a(b*)c", "abbbbbbbbc", 5 * chunk - 9, "" },
+        { "a.*c", "a", chunk - 1, "" },
+        { "a.*c", "ac", 4 * chunk - 1, "" },
+        { "a.*c", "a", chunk + 5, "ac" },
+        { "a(x*)c", "a", 10, "c" },
+        { "(.*)z", "", 0, "" },
+        { "b(x*)", "b", 3 * chunk - 1, "" },
+    };
+    int nthreads[] = { 2, 4 };
+
+    for(std::size_t i = 0; i < sizeof(cases) / sizeof(*cases); ++i)
+    {
+        boost::shared_ptr<Regex const> re = Regex::compile(cases[i].pattern);
+        CHECK(re);
+        if(!re)
+            continue;
+        std::string text(6 * chunk, 'x');
+        text.replace(cases[i].at, std::strlen(cases[i].text), cases[i].text);
+        text += cases[i].tail;
+        Matcher<Iter> m(*re);
+        std::string expected = spans(m, m.match(text.begin(), text.end()));
+        for(std::size_t k = 0; k < sizeof(nthreads) / sizeof(*nthreads); ++k)
+        {
+            std::string actual = spans(m, parallel_search(m, Iter(text.begin()), Iter(text.end()), nthreads[k]));
+            if(actual != expected)
+            {
+                std::cout << cases[i].pattern << " at " << cases[i].at << " on " << nthreads[k]
+                          << " threads: match " << expected << ", parallel_search " << actual << '\n';
+                ++failures;
+            }
+        }
+    }
+}
+
+// More than ten groups: the submatches past the ninth are tracked
+// like the others, nested or not, and stay unmatched when their
+// group takes no part in the match.
+void test_many_groups()
+{
+    struct
+    {
+        char const *pattern;
+        char const *text;
+        char const *expected;
+    } const cases[] = {
+        {
+            "(a)(b)(c)(d)(e)(f)(g)(h)(i)(j)(k)(l)", "xabcdefghijkl",
+            "(1,13)(1,2)(2,3)(3,4)(4,5)(5,6)(6,7)(7,8)(8,9)(9,10)(10,11)(11,12)(12,13)"
+        },
+        {
+            "((((((((((((a)b)c)d)e)f)g)h)i)j)k)l)", "abcdefghijkl",
+            "(0,12)(0,12)(0,11)(0,10)(0,9)(0,8)(0,7)(0,6)(0,5)(0,4)(0,3)(0,2)(0,1)"
+        },
+        {
+            "(a)(b)(c)(d)(e)(f)(g)(h)(i)(j)((x)|(y))(z)", "abcdefghijyz",
+            "(0,12)(0,1)(1,2)(2,3)(3,4)(4,5)(5,6)(6,7)(7,8)(8,9)(9,10)(10,11)(?,?)(10,11)(11,12)"
+        },
+        {
+            "(a)(b)(c)(d)(e)(f)(g)(h)(i)(j)(k(m))?(k)", "abcdefghijk",
+            "(0,11)(0,1)(1,2)(2,3)(3,4)(4,5)(5,6)(6,7)(7,8)(8,9)(9,10)(?,?)(?,?)(10,11)"
+        },
+    };
+    int matchtypes[] = { LeftmostBiased, LeftmostLongest };
+
+    for(std::size_t i = 0; i < sizeof(cases) / sizeof(*cases); ++i)
+    {
+        boost::shared_ptr<Regex const> re = Regex::compile(cases[i].pattern);
+        CHECK(re);
+        if(!re)
+            continue;
+        CHECK(re->impl.nparen >= 12);
+        Matcher<Iter> m(*re);
+        std::string text(cases[i].text);
+        for(std::size_t k = 0; k < 2; ++k)
+        {
+            std::string actual = spans(m, m.match(text.begin(), text.end(), MatchOptions(matchtypes[k])));
+            if(actual != cases[i].expected)
+            {
+                std::cout << cases[i].pattern << " on \"" << text << "\": " << actual
+                          << ", expected " << cases[i].expected << '\n';
+                ++failures;
+            }
+        }
+    }
+}
+
+// The submatches sm found, as spans() gives them for a Matcher.
+std::string spans(StreamMatcher const &sm, bool matched)
+{
+    if(!matched)
+        return "-";
+    std::ostringstream out;
+    for(std::size_t i = 0; i < sm.m.nsub; ++i)
+    {
+        if(sm.matched(i))
+            out << '(' << sm.first(i) << ',' << sm.second(i) << ')';
+        else
+            out << "(?,?)";
+    }
+    return out.str();
+}
+
+// A StreamMatcher fed the input a few bytes at a time has to find
+// the submatches match() finds in the whole of it, also when the
+// prefix, a capture or the match itself is split between chunks.
+void test_stream()
+{
+    char const *patterns[] = {
+        "abc", "a(b*)c", "(a|ab)(c|bcd)", "needle(1|2)+x", "x*", "(ab)*c", "a.*c", "z"
+    };
+    char const *texts[] = {
+        "abc", "xxabcyy", "abbbbbbc", "zzabcdzz", "hay needle1 needle1212x hay",
+        "ababababc", "a----c----c", "", "aaaaab"
+    };
+    std::size_t sizes[] = { 1, 2, 7 };
+
+    for(std::size_t p = 0; p < sizeof(patterns) / sizeof(*patterns); ++p)
+    {
+        boost::shared_ptr<Regex const> re = Regex::compile(patterns[p]);
+        CHECK(re);
+        if(!re)
+            continue;
+        Matcher<Iter> m(*re);
+        for(std::size_t t = 0; t < sizeof(texts) / sizeof(*texts); ++t)
+        {
+            std::string text(texts[t]);
+            std::string expected = spans(m, m.match(text.begin(), text.end()));
+            for(std::size_t k = 0; k < sizeof(sizes) / sizeof(*sizes); ++k)
+            {
+                StreamMatcher sm(*re);
+                for(std::size_t i = 0; i < text.size(); i += sizes[k])
+                {
+                    std::string piece(text, i, sizes[k]);
+                    if(!sm.feed(piece.data(), piece.size()))
+                        break;
+                }
+                std::string actual = spans(sm, sm.finish());
+                if(actual != expected)
+                {
+                    std::cout << patterns[p] << " on \"" << text << "\" in chunks of " << sizes[k]
+                              << ": match " << expected << ", StreamMatcher " << actual << '\n';
+                    ++failures;
+                }
+            }
+        }
+    }
+}
+
+// The literals found for a regex, as "prefix/required".
+std::string literals(char const *pattern)
+{
+    boost::shared_ptr<Regex const> re = Regex::compile(pattern);
+    return re ? re->impl.prefix + '/' + re->impl.required : "?";
+}
+
+// The prefix and the required literal are what every match has to
+// start with and contain, so skipping ahead to them or rejecting
+// input without them must find what the matcher finds without them.
+void test_literals()
+{
+    CHECK(literals("abc|abd") == "/");
+    CHECK(literals("x(abc|abd)") == "x/x");
+    CHECK(literals("(ab)?cd") == "/cd");
+    CHECK(literals("ab?cde") == "a/cde");
+    CHECK(literals("a.cd") == "a/cd");
+    CHECK(literals("ab*cde") == "a/cde");
+    CHECK(literals("(abc)*de") == "/de");
+    CHECK(literals("x*(ab)(cd)ef") == "/abcdef");
+    CHECK(literals("(a(bc|bd)e)+f") == "a/a");
+
+    char const *patterns[] = {
+        "abc|abd", "x(abc|abd)", "(abc|xbc)d", "(ab)?cd", "ab?cde", "a(bc)?d",
+        "a.cd", ".abc.", "ab*cde", "(abc)*de", "x*(ab)(cd)ef", "abc*",
+        "(a(bc|bd)e)+f", "(ab|cd)*ef(gh)?"
+    };
+    char const *texts[] = {
+        "", "abc", "abd", "xabcd", "xxabcdef", "cd", "acd", "abcd", "abbbcde",
+        "zzabcdezz", "xbcd", "abcabcde", "abcdabdef", "abcefabdef", "cdabef",
+        "ababcdefgh", "aaxcd", "ab", "abcdeabcdefgh"
+    };
+    int matchtypes[] = { LeftmostBiased, LeftmostLongest };
+
+    for(std::size_t p = 0; p < sizeof(patterns) / sizeof(*patterns); ++p)
+    {
+        boost::shared_ptr<Regex const> re = Regex::compile(patterns[p]);
+        CHECK(re);
+        if(!re)
+            continue;
+        REImpl impl(re->impl);
+        impl.prefix.clear();
+        impl.required.clear();
+        Regex plain(impl);
+        Matcher<Iter> m(*re), n(plain);
+        for(std::size_t t = 0; t < sizeof(texts) / sizeof(*texts); ++t)
+        {
+            std::string text(texts[t]);
+            for(std::size_t k = 0; k < 2; ++k)
+            {
+                MatchOptions opts(matchtypes[k]);
+                std::string expected = spans(n, n.match(text.begin(), text.end(), opts));
+                std::string actual = spans(m, m.match(text.begin(), text.end(), opts));
+                std::string expspan = span(n, n.matchspan(text.begin(), text.end(), opts));
+                std::string actspan = span(m, m.matchspan(text.begin(), text.end(), opts));
+                if(actual != expected || actspan != expspan)
+                {
+                    std::cout << patterns[p] << " on \"" << text << "\": match " << actual
+                              << ", matchspan " << actspan << ", without literals " << expected
+                              << ", " << expspan << '\n';
+                    ++failures;
+                }
+            }
+            CHECK(m.search(text.begin(), text.end()) == n.search(text.begin(), text.end()));
+        }
+    }
+}
+
+int main()
+{
+    test_matchspan();
+    test_options();
+    test_flush();
+    test_regexset();
+    test_parallel_search();
+    test_literals();
+    test_stream();
+    test_many_groups();
+    return test_result();
+}
+
+/*
+ * Distributed under the Boost Software License, Version 1.0. (See
+ * accompanying file LICENSE_1_0.txt or copy at
+ * http://www.boost.org/LICENSE_1_0.txt)
+ *
+ */
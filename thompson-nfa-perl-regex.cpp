@@ -6,31 +6,49 @@
 //
 // Executes repetitions likt Perl.
 //
+// Uses a lazily built DFA, or a bit-parallel simulation for
+// small regexes, when submatches are not needed.
+//
 // Requires Boost C++ Libraries, see http://boost.org
 //
-// g++ -I $BOOST_ROOT nfa-perl.cpp
+// g++ -I $BOOST_ROOT nfa-perl.cpp -L $BOOST_ROOT/stage/lib -lboost_thread
 //	a.out '(a*)+' aaa           # (0,3)(3,3)
 //	a.out '(a|aa)(a|aa)' aaa    # (0,2)(0,1)(1,2)
 // 
+// Define NFA_PERL_NO_MAIN to include the matcher in another
+// program, such as thompson-nfa-perl-regex-bench.cpp, without the
+// demo's main() and parser tracing.
+//
 // Copyright (c) 2007 Russ Cox.
 // Copyright (c) 2011 Eric Niebler.
 // Can be distributed under the Boost Softwate License 1.0, see bottom of file.
 
+#ifndef NFA_PERL_NO_MAIN
 #define BOOST_SPIRIT_DEBUG
+#endif
 #include <cstring>
+#include <algorithm>
+#include <cstddef>
 #include <deque>
+#include <map>
+#include <string>
 #include <vector>
 #include <utility>
 #include <iostream>
 #include <iomanip>
+#include <iterator>
 #include <boost/config/warning_disable.hpp>
-#include <boost/array.hpp>
+#include <boost/assert.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/next_prior.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/spirit/include/qi.hpp>
 #include <boost/spirit/include/phoenix_core.hpp>
 #include <boost/spirit/include/phoenix_operator.hpp>
 #include <boost/spirit/include/phoenix_object.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/tss.hpp>
 
 namespace qi = boost::spirit::qi;
 namespace ascii = boost::spirit::ascii;
@@ -48,9 +66,18 @@ enum
     RepeatLikePerl = 1,
 };
 
-int debug;
-int matchtype = LeftmostBiased;
-int reptype = RepeatMinimal;
+// How a Matcher runs: which match it prefers, how repetitions
+// behave, and whether it traces the NFA on std::cout.
+struct MatchOptions
+{
+    explicit MatchOptions(int matchtype_ = LeftmostBiased, int reptype_ = RepeatMinimal, int debug_ = 0)
+      : matchtype(matchtype_), reptype(reptype_), debug(debug_)
+    {}
+
+    int matchtype;
+    int reptype;
+    int debug;
+};
 
 enum SubState
 {
@@ -59,11 +86,6 @@ enum SubState
     Matched = 2
 };
 
-enum
-{
-    NSUB = 10
-};
-
 template<typename Iter>
 struct Sub
   : std::pair<Iter, Iter>
@@ -78,8 +100,8 @@ struct Sub
         // don't copy singular iterators
         switch(matched = sub.matched)
         {
-        case Matched:    second = sub.second;
-        case Incomplete: first  = sub.first;
+        case Matched:    this->second = sub.second;
+        case Incomplete: this->first  = sub.first;
         default:;
         }
         return *this;
@@ -113,69 +135,226 @@ private:
     {}
 };
 
-template<typename Iter>
-struct Thread;
+// A State as the matcher runs it: the graph is flattened into one
+// array of these, and out and out1 are indexes into it.  Index 0
+// stands for no state, so a State's id is its index.
+struct Inst
+{
+    boost::int32_t op;
+    boost::int32_t data;
+    boost::uint32_t out;
+    boost::uint32_t out1;
+};
+
+// The compiled program.  It holds no pointers, so it can be
+// copied with memcpy and shared read-only between matchers.
+struct Prog
+{
+    Prog(std::deque<State> const &states, State const *start_)
+      : inst(states.size() + 1), start(start_ ? start_->id : 0)
+    {
+        Inst const none = {0, 0, 0, 0};
+        inst[0] = none;
+        for(std::size_t i = 0; i < states.size(); ++i)
+        {
+            State const &s = states[i];
+            Inst const in =
+            {
+                s.op, s.data,
+                boost::uint32_t(s.out ? s.out->id : 0),
+                boost::uint32_t(s.out1 ? s.out1->id : 0)
+            };
+            inst[s.id] = in;
+        }
+    }
+
+    std::vector<Inst> inst;
+    boost::uint32_t start;
+};
+
+// An instruction together with the matcher's scratch for it,
+// so that stepping a thread touches one cache line.
+struct Slot
+{
+    Inst inst;
+    int visits;
+};
 
+// A reference-counted set of submatches.  Threads share
+// one until a paren records a position, which takes a copy.
 template<typename Iter>
-struct StateEx
+struct Capture
 {
-    StateEx()
-      : lastlist(0), visits(0), lastthread(0)
+    explicit Capture(std::size_t nsub)
+      : ref(0), sub(nsub)
     {}
 
-    int lastlist;
-    int visits;
-    Thread<Iter> *lastthread;
+    int ref;
+    std::vector<Sub<Iter> > sub;
 };
 
+// Arena of same-sized Captures, recycled through a free list
+// so that matching allocates nothing once it has warmed up.
 template<typename Iter>
-struct Extras
+struct CapturePool
 {
-    Extras(std::size_t nstates)
-      : listid(0), stateex(nstates + 1, StateEx<Iter>())
+    explicit CapturePool(std::size_t nsub_)
+      : nsub(nsub_), arena(), free()
     {}
-    
-    int listid;
-    std::vector<StateEx<Iter> > stateex;
+
+    // A capture with ref 1; its submatches are whatever
+    // the last user left in it.
+    Capture<Iter> *alloc()
+    {
+        Capture<Iter> *c;
+        if(free.empty())
+        {
+            arena.push_back(Capture<Iter>(nsub));
+            c = &arena.back();
+        }
+        else
+        {
+            c = free.back();
+            free.pop_back();
+        }
+        c->ref = 1;
+        return c;
+    }
+
+    Capture<Iter> *copy(Capture<Iter> const *from)
+    {
+        Capture<Iter> *c = alloc();
+        std::copy(from->sub.begin(), from->sub.end(), c->sub.begin());
+        return c;
+    }
+
+    void incref(Capture<Iter> *c)
+    {
+        ++c->ref;
+    }
+
+    void decref(Capture<Iter> *c)
+    {
+        if(--c->ref == 0)
+            free.push_back(c);
+    }
+
+    std::size_t nsub;
+    std::deque<Capture<Iter> > arena;
+    std::vector<Capture<Iter> *> free;
 };
 
 template<typename Iter>
 struct Thread
 {
-    State const *state;
-    boost::array<Sub<Iter>, NSUB> match;
+    boost::uint32_t pc;
+    Capture<Iter> *cap;
 };
 
+// The threads of one step, as a sparse set indexed by pc:
+// t holds the threads in order and sparse[pc] is where to look
+// for pc's thread.  Membership is checked against t itself, so
+// emptying the set is just n = 0 and nothing needs clearing.
 template<typename Iter>
 struct List
 {
     explicit List(std::size_t nstates)
-      : t(nstates, Thread<Iter>()), n(0)
+      : t(nstates + 1, Thread<Iter>()), sparse(nstates + 1, 0), n(0)
     {}
 
+    Thread<Iter> *find(boost::uint32_t pc)
+    {
+        boost::uint32_t i = sparse[pc];
+        return i < (boost::uint32_t)n && t[i].pc == pc ? &t[i] : 0;
+    }
+
+    Thread<Iter> *add(boost::uint32_t pc)
+    {
+        sparse[pc] = n;
+        t[n].pc = pc;
+        return &t[n++];
+    }
+
     std::vector<Thread<Iter> > t;
+    std::vector<boost::uint32_t> sparse;
     int n;
 };
 
 struct REImpl
 {
     REImpl()
-      : start(0), nparen(0), states(new std::deque<State>)
+      : start(0), nparen(0), npattern(0), states(new std::deque<State>)
     {}
 
+    // Run the compiler's passes over the finished graph.
+    void compile()
+    {
+        findliterals();
+        prog.reset(new Prog(*states, start));
+    }
+
     State *state(int op, int data, State const *out=0, State const *out1=0)
     {
         states->push_back(State(op, data, states->size()+1, out, out1));
         return &states->back();
     }
 
-    void dump()
+    void dump() const
     {
         std::vector<bool> seen(states->size() + 1);
         dump(start, seen);
+        std::cout << "prefix \"" << prefix << "\", required \"" << required << "\"\n";
+    }
+
+    // Find the literal every match must start with, and the
+    // longest literal every match must contain.  Both are chains
+    // of Char states joined only by parens; the required one
+    // starts at a Char that every path to Match goes through.
+    // A chain's Chars are skipped as starts of chains of their
+    // own, which could only be shorter.
+    void findliterals()
+    {
+        prefix = chain(start);
+        required = prefix;
+        std::vector<State const *> doms = dominators();
+        std::vector<bool> chained(states->size() + 1, false);
+        for(std::size_t i = 0; i < doms.size(); ++i)
+        {
+            State const *s = doms[i];
+            if(s->op != Char || s->data < 0 || chained[s->id])
+                continue;
+            std::string lit;
+            for(; s != 0; s = s->out)
+            {
+                if(s->op == Char && s->data >= 0)
+                {
+                    lit += (char)s->data;
+                    chained[s->id] = true;
+                }
+                else if(s->op != LParen && s->op != RParen)
+                    break;
+            }
+            if(lit.size() > required.size())
+                required.swap(lit);
+        }
+    }
+
+    // The characters of the Char states that must follow s.
+    // Chars that can never match a byte end the chain.
+    static std::string chain(State const *s)
+    {
+        std::string lit;
+        for(; s != 0; s = s->out)
+        {
+            if(s->op == Char && s->data >= 0)
+                lit += (char)s->data;
+            else if(s->op != LParen && s->op != RParen)
+                break;
+        }
+        return lit;
     }
 
-    void dump(State const *s, std::vector<bool> &seen)
+    void dump(State const *s, std::vector<bool> &seen) const
     {
         if(s == 0 || seen[s->id])
             return;
@@ -205,7 +384,7 @@ struct REImpl
             break;
 
         case Match:
-            std::cout << "match\n";
+            std::cout << "match " << s->data << '\n';
             break;
 
         default:
@@ -224,9 +403,145 @@ struct REImpl
 
     State const *start;
     int nparen;
+    int npattern;
     boost::shared_ptr<std::deque<State> > states;
+    boost::shared_ptr<Prog const> prog;
+    std::string prefix, required;
+
+private:
+    // The states every path from start to a Match goes through,
+    // nearest the start first.  Id 0 stands for an exit that all
+    // the Match states lead to, and its dominators are found with
+    // the iterative algorithm of Cooper, Harvey and Kennedy over
+    // a postorder numbering: a few linear passes, however the
+    // regex nests.
+    std::vector<State const *> dominators() const
+    {
+        std::vector<State const *> doms;
+        std::size_t n = states->size() + 1;
+        std::vector<int> po(n, -1);
+        std::vector<std::size_t> order;
+        std::vector<std::vector<std::size_t> > preds(n);
+        if(start == 0)
+            return doms;
+        number(start, po, order, preds);
+        if(po[0] < 0)
+            return doms;
+
+        std::vector<std::size_t> idom(n, n);
+        idom[start->id] = start->id;
+        for(bool changed = true; changed; )
+        {
+            changed = false;
+            for(std::size_t i = order.size(); i-- > 0; )
+            {
+                std::size_t b = order[i];
+                if(b == start->id)
+                    continue;
+                std::size_t d = n;
+                for(std::size_t j = 0; j < preds[b].size(); ++j)
+                {
+                    std::size_t p = preds[b][j];
+                    if(idom[p] == n)
+                        continue;
+                    d = d == n ? p : intersect(p, d, idom, po);
+                }
+                if(idom[b] != d)
+                {
+                    idom[b] = d;
+                    changed = true;
+                }
+            }
+        }
+
+        for(std::size_t d = idom[0]; ; d = idom[d])
+        {
+            doms.push_back(&(*states)[d - 1]);
+            if(d == start->id)
+                break;
+        }
+        std::reverse(doms.begin(), doms.end());
+        return doms;
+    }
+
+    // Number the states reachable from s in postorder, and note
+    // the arrows into each; a Match has one into the exit, 0.
+    void number(State const *s, std::vector<int> &po, std::vector<std::size_t> &order,
+        std::vector<std::vector<std::size_t> > &preds) const
+    {
+        po[s->id] = 0;
+        State const *succ[] = { s->out, s->out1 };
+        for(int i = 0; i < 2; ++i)
+        {
+            if(succ[i] == 0)
+                continue;
+            preds[succ[i]->id].push_back(s->id);
+            if(po[succ[i]->id] < 0)
+                number(succ[i], po, order, preds);
+        }
+        if(s->op == Match)
+        {
+            preds[0].push_back(s->id);
+            if(po[0] < 0)
+            {
+                po[0] = (int)order.size();
+                order.push_back(0);
+            }
+        }
+        po[s->id] = (int)order.size();
+        order.push_back(s->id);
+    }
+
+    static std::size_t intersect(std::size_t a, std::size_t b,
+        std::vector<std::size_t> const &idom, std::vector<int> const &po)
+    {
+        while(a != b)
+        {
+            while(po[a] < po[b])
+                a = idom[a];
+            while(po[b] < po[a])
+                b = idom[b];
+        }
+        return a;
+    }
 };
 
+// Find lit in [first, last); return last if it is not there.
+template<typename Iter>
+Iter find_literal(Iter first, Iter last, std::string const &lit)
+{
+    return std::search(first, last, lit.begin(), lit.end());
+}
+
+// Contiguous input: memchr, which the C library vectorizes,
+// skips to the candidates for the first byte.
+inline char const *find_literal(char const *first, char const *last, std::string const &lit)
+{
+    std::size_t n = lit.size();
+    if(n == 0)
+        return first;
+    while(std::size_t(last - first) >= n)
+    {
+        void const *p = std::memchr(first, lit[0], (last - first) - n + 1);
+        if(p == 0)
+            break;
+        first = static_cast<char const *>(p);
+        if(std::memcmp(first, lit.data(), n) == 0)
+            return first;
+        ++first;
+    }
+    return last;
+}
+
+inline std::string::const_iterator
+find_literal(std::string::const_iterator first, std::string::const_iterator last, std::string const &lit)
+{
+    if(first == last)
+        return lit.empty() ? first : last;
+    char const *p = &*first;
+    return first + (find_literal(p, p + (last - first), lit) - p);
+}
+
 // Since the out pointers in the list are always
 // uninitialized, we use the pointers themselves
 // as storage for the Ptrlists.
@@ -330,8 +645,6 @@ struct paren_impl : frag3_result
 {
     Frag operator()(REImpl &impl, Frag f, int n) const
     {
-        if(n >= NSUB)
-            return f;
         State *s1 = impl.state(LParen, n, f.start, 0);
         State *s2 = impl.state(RParen, n, 0, 0);
         patch(f.out, s2);
@@ -440,7 +753,7 @@ struct do_regex_impl
     void operator()(REImpl &impl, Frag f) const
     {
         f = paren_impl()(impl, f, 0);
-        State *s = impl.state(Match, 0, 0, 0);
+        State *s = impl.state(Match, impl.npattern++, 0, 0);
         patch(f.out, s);
         impl.start = f.start;
     }
@@ -530,202 +843,1024 @@ struct regex_grammar
     qi::rule<Iter, Frag(REImpl&), qi::locals<int> > single;
 };
 
-// Is match a longer than match b?
-// If so, return 1; if not, 0.
-template<typename Iter>
-int longer(boost::array<Sub<Iter>, NSUB> const &a, boost::array<Sub<Iter>, NSUB> const &b)
-{
-    if(a[0].matched == Unmatched)
-        return 0;
-    if(b[0].matched == Unmatched || a[0].first < b[0].first)
-        return 1;
-    if(a[0].first == b[0].first && a[0].second > b[0].second)
-        return 1;
-    return 0;
-}
-
-template<typename Iter>
-struct Matcher
+// The NFA as seen by the DFA: only the states that consume
+// a character (Char, Any) are kept, each with the precomputed
+// set of consuming states reachable by unlabeled arrows after it
+// and the ids of the patterns whose Match is reachable after it.
+// Captures play no part here.  A reversed program, which runs
+// the same language backwards, is used to find where matches start;
+// it does not tell patterns apart and reports every match as 0.
+struct DFAProg
 {
-    Matcher(REImpl const &impl_)
-      : impl(impl_), begin(), end(), subs(), dummy()
-      , l1(impl.states->size()), l2(impl.states->size())
-      , extras(impl.states->size())
-    {}
-
-    // Add s to l, following unlabeled arrows.
-    // Next character to read is p.
-    void addstate(List<Iter> *l, State const *s, boost::array<Sub<Iter>, NSUB> &m, Iter icur)
+    explicit DFAProg(REImpl const &impl, bool reverse = false)
+      : nodes(impl.states->size() + 1, (State const *)0)
+      , next(impl.states->size() + 1)
+      , nextpats(impl.states->size() + 1)
+      , nextmatch(impl.states->size() + 1, false)
+      , start(), startpats(), startmatch(false)
+      , first(256, false), skipfirst(false)
+      , mark(impl.states->size() + 1, 0), markid(0)
     {
-        if(s == 0)
-            return;
-
-        StateEx<Iter> &ss = extras.stateex[s->id];
-        if(ss.lastlist == extras.listid)
+        for(std::size_t i = 0; i < impl.states->size(); ++i)
         {
-            if(++ss.visits > 2)
-                return;
+            State const *s = &(*impl.states)[i];
+            if(s->op == Char || s->op == Any)
+                nodes[s->id] = s;
+        }
 
-            switch(matchtype)
+        std::vector<std::size_t> fwdstart;
+        std::vector<int> fwdstartpats;
+        closure(impl.start, fwdstart, fwdstartpats);
+        for(std::size_t id = 1; id < nodes.size(); ++id)
+        {
+            if(nodes[id] == 0)
+                continue;
+            std::vector<std::size_t> succ;
+            std::vector<int> pats;
+            closure(nodes[id]->out, succ, pats);
+            if(!reverse)
             {
-            case LeftmostBiased:
-                if(reptype == RepeatMinimal || ++ss.visits > 2)
-                    return;
-                break;
-            case LeftmostLongest:
-                if(!longer(m, ss.lastthread->match))
-                    return;
-                break;
+                next[id].swap(succ);
+                nextpats[id].swap(pats);
+                continue;
             }
+            // Reversed: an arrow id -> s becomes s -> id, a state that
+            // can reach Match becomes a start state, and a start state
+            // becomes one that leads to Match.
+            for(std::size_t j = 0; j < succ.size(); ++j)
+                next[succ[j]].push_back(id);
+            if(!pats.empty())
+                start.push_back(id);
+        }
+
+        if(reverse)
+        {
+            for(std::size_t j = 0; j < fwdstart.size(); ++j)
+                nextpats[fwdstart[j]].assign(1, 0);
+            if(!fwdstartpats.empty())
+                startpats.assign(1, 0);
         }
         else
         {
-            ss.lastlist = extras.listid;
-            ss.lastthread = &l->t[l->n++];
-            ss.visits = 1;
+            start.swap(fwdstart);
+            startpats.swap(fwdstartpats);
         }
 
-        if(ss.visits == 1)
+        for(std::size_t id = 1; id < nodes.size(); ++id)
+            nextmatch[id] = !nextpats[id].empty();
+        startmatch = !startpats.empty();
+
+        // the bytes that can begin a match, when not all of them can
+        for(std::size_t j = 0; j < start.size(); ++j)
         {
-            ss.lastthread->state = s;
-            ss.lastthread->match = m;
+            for(int c = 0; c < 256; ++c)
+                first[c] = first[c] || accepts(start[j], c);
         }
+        skipfirst = !startmatch && std::count(first.begin(), first.end(), true) < 256;
+    }
+
+    // Does state s match character c?
+    bool accepts(std::size_t id, int c) const
+    {
+        return nodes[id]->op == Any || c == nodes[id]->data;
+    }
+
+    std::vector<State const *> nodes;
+    std::vector<std::vector<std::size_t> > next;
+    std::vector<std::vector<int> > nextpats;
+    std::vector<bool> nextmatch;
+    std::vector<std::size_t> start;
+    std::vector<int> startpats;
+    bool startmatch;
+    std::vector<bool> first;
+    bool skipfirst;
+
+private:
+    // Collect the consuming states reachable from s by
+    // unlabeled arrows, and the patterns of the Match states.
+    void closure(State const *s, std::vector<std::size_t> &ids, std::vector<int> &pats)
+    {
+        ++markid;
+        closure1(s, ids, pats);
+        std::sort(ids.begin(), ids.end());
+        std::sort(pats.begin(), pats.end());
+    }
+
+    void closure1(State const *s, std::vector<std::size_t> &ids, std::vector<int> &pats)
+    {
+        if(s == 0 || mark[s->id] == markid)
+            return;
+        mark[s->id] = markid;
 
         switch(s->op)
         {
+        case Char:
+        case Any:
+            ids.push_back(s->id);
+            break;
+        case Match:
+            pats.push_back(s->data);
+            break;
         case Split:
-            // follow unlabeled arrows
-            addstate(l, s->out, m, icur);
-            addstate(l, s->out1, m, icur);
+            closure1(s->out, ids, pats);
+            closure1(s->out1, ids, pats);
             break;
-
-        case LParen:
-        {   // record left paren location and keep going
-            Sub<Iter> save = m[s->data];
-            m[s->data].first = icur;
-            m[s->data].matched = Incomplete;
-            addstate(l, s->out, m, icur);
-            // restore old information before returning.
-            m[s->data] = save;
-        }   break;
-
-        case RParen:
-        {   // record right paren location and keep going
-            Sub<Iter> save = m[s->data];
-            m[s->data].second = icur;
-            m[s->data].matched = Matched;
-            addstate(l, s->out, m, icur);
-            // restore old information before returning.
-            m[s->data] = save;
-        }   break;
-
         default:
+            closure1(s->out, ids, pats);
             break;
         }
     }
 
-    // Step the NFA from the states in clist
-    // past the character c,
-    // to create next NFA state set nlist.
-    // Record best match so far in *this.
-    void
-    step(List<Iter> *clist, int c, Iter icur, List<Iter> *nlist)
+    std::vector<int> mark;
+    int markid;
+};
+
+// A DFA state: the sorted ids of the NFA states the NFA could
+// be in, the patterns with a match ending (or, reversed,
+// beginning) here, and the lazily filled transitions out of it.
+struct DState
+{
+    DState(std::vector<std::size_t> const &ids_, std::vector<int> const &pats_)
+      : ids(ids_), pats(pats_), match(!pats_.empty())
     {
-        if(debug)
-        {
-            dumplist(clist, impl.nparen);
-            std::cout << (char)c << " (" << c << ")\n";
-        }
+        std::fill_n(next, 256, (DState *)0);
+    }
 
-        ++extras.listid;
-        nlist->n = 0;
+    std::vector<std::size_t> ids;
+    std::vector<int> pats;
+    bool match;
+    DState *next[256];
+};
 
-        for(int i = 0; i < clist->n; ++i)
-        {
-            Thread<Iter> *t = &clist->t[i];
+enum
+{
+    DFAMemoryBudget = 1 << 20
+};
 
-            if(matchtype == LeftmostLongest)
-            {
-                // stop any threads that are worse than the
-                // leftmost longest found so far.  the threads
-                // will end up ordered on the list by start point,
-                // so if this one is too far right, all the rest are too.
-                if(subs[0].matched != Unmatched && subs[0].first < t->match[0].first)
-                {
-                    break;
-                }
-            }
+// Subset construction done on the fly, one transition at a time,
+// as the input asks for it.  The states live in a cache bounded by
+// a memory budget; when the budget runs out the whole cache is
+// flushed and rebuilt from whatever state the scan was in.
+struct LazyDFA
+{
+    typedef std::pair<std::vector<std::size_t>, std::vector<int> > Key;
+    typedef std::map<Key, DState *> Cache;
+    typedef DState *state_type;
 
-            switch(t->state->op)
-            {
-            case Char:
-                if(c == t->state->data)
-                {
-                    addstate(nlist, t->state->out, t->match, icur);
-                }
-                break;
+    LazyDFA(DFAProg const &prog_, bool anchored_, std::size_t budget_ = DFAMemoryBudget)
+      : prog(prog_), anchored(anchored_), budget(budget_)
+      , used(0), startstate(0), flushes(0)
+    {}
 
-            case Any:
-                addstate(nlist, t->state->out, t->match, icur);
-                break;
+    ~LazyDFA()
+    {
+        flush();
+    }
 
-            case Match:
-                switch(matchtype)
-                {
-                case LeftmostBiased:
-                    // best so far ...
-                    subs = t->match;
-                    // ... because we cut off the worse ones right now!
-                    return;
-                case LeftmostLongest:
-                    if(longer(t->match, subs))
-                    {
-                        subs = t->match;
-                    }
-                    break;
-                default:
-                    break;
-                }
-                break;
-            default:
-                break;
-            }
-        }
+    DState *start()
+    {
+        if(startstate == 0)
+            startstate = intern(Key(prog.start, prog.startpats));
+        return startstate;
+    }
 
-        // start a new thread if no match yet 
-        if(subs[0].matched == Unmatched)
-        {
-            addstate(nlist, impl.start, dummy, icur);
-        }
+    // No NFA state left and no match: nothing more can happen.
+    bool dead(DState const *d) const
+    {
+        return d->ids.empty() && !d->match;
     }
 
-    // Compute initial thread list 
-    List<Iter> *startlist(Iter icur, List<Iter> *l)
+    static bool matched(DState const *d)
     {
-        List<Iter> empty(0);
-        std::fill_n(&subs[0], (int)NSUB, Sub<Iter>());
-        step(&empty, 0, icur, l);
-        return l;
+        return d->match;
     }
 
-    bool match(Iter icur, Iter iend)
+    bool atstart(DState const *d) const
     {
-        begin = icur; end = iend;
-        List<Iter> *clist = startlist(icur, &l1);
-        List<Iter> *nlist = &l2;
+        return d == startstate;
+    }
+
+    // The state reached from d on character c.
+    DState *next(DState *d, int c)
+    {
+        if(d->next[c])
+            return d->next[c];
 
-        for(; icur != end && clist->n > 0; ++icur)
+        Key key;
+        if(!anchored)
         {
-            int c = *icur & 0xFF;
-            step(clist, c, boost::next(icur), nlist);
-            std::swap(clist, nlist);
+            key.first = prog.start;
+            key.second = prog.startpats;
         }
+        for(std::size_t i = 0; i < d->ids.size(); ++i)
+        {
+            std::size_t id = d->ids[i];
+            if(!prog.accepts(id, c))
+                continue;
+            key.first.insert(key.first.end(), prog.next[id].begin(), prog.next[id].end());
+            key.second.insert(key.second.end(), prog.nextpats[id].begin(), prog.nextpats[id].end());
+        }
+        std::sort(key.first.begin(), key.first.end());
+        key.first.erase(std::unique(key.first.begin(), key.first.end()), key.first.end());
+        std::sort(key.second.begin(), key.second.end());
+        key.second.erase(std::unique(key.second.begin(), key.second.end()), key.second.end());
 
-        step(clist, 0, icur, nlist);
-        return subs[0].matched == Matched;
+        Cache::iterator it = cache.find(key);
+        if(it != cache.end())
+            return d->next[c] = it->second;
+
+        if(used + cost(key) > budget)
+        {
+            // d goes away with the rest of the cache; the start
+            // state is made again so atstart() keeps working
+            flush();
+            DState *n = intern(key);
+            start();
+            return n;
+        }
+
+        return d->next[c] = intern(key);
     }
 
-    void printmatch(boost::array<Sub<Iter>, NSUB> const &m, int n)
+    // The state of this DFA for the NFA states of d, a state of
+    // another DFA over the same program; how an unanchored scan
+    // stops starting new threads and carries on anchored.
+    DState *import(DState const *d)
+    {
+        return intern(Key(d->ids, d->pats));
+    }
+
+    void flush()
+    {
+        for(Cache::iterator it = cache.begin(); it != cache.end(); ++it)
+            delete it->second;
+        cache.clear();
+        used = 0;
+        startstate = 0;
+        ++flushes;
+    }
+
+    DFAProg const &prog;
+    bool anchored;
+    std::size_t budget, used;
+    Cache cache;
+    DState *startstate;
+    int flushes;
+
+private:
+    static std::size_t cost(Key const &key)
+    {
+        // the state, its lists twice (key and state), and the map node
+        return sizeof(DState) + 2 * key.first.size() * sizeof(std::size_t)
+            + 2 * key.second.size() * sizeof(int) + 4 * sizeof(void *);
+    }
+
+    DState *intern(Key const &key)
+    {
+        Cache::iterator it = cache.find(key);
+        if(it != cache.end())
+            return it->second;
+        DState *d = new DState(key.first, key.second);
+        cache.insert(std::make_pair(key, d));
+        used += cost(key);
+        return d;
+    }
+
+    LazyDFA(LazyDFA const &);
+    LazyDFA &operator=(LazyDFA const &);
+};
+
+// Bit-parallel (Shift-And style) simulation of a DFAProg with at
+// most MaxStates consuming states, for which no cache is needed:
+// the whole active set lives in two machine words.  Every arrow
+// into a consuming state reads that state's character, as in a
+// Glushkov automaton, so a step keeps the states that accept c
+// (the set and chars[c]) and ORs in their successors, looked up
+// eight states at a time in precomputed tables.
+struct BitNFA
+{
+    enum
+    {
+        Words = 2,
+        MaxStates = Words * 64
+    };
+
+    struct Set
+    {
+        boost::uint64_t w[Words];
+        bool match;
+    };
+
+    typedef Set state_type;
+
+    // The analysis pass: can prog be simulated in Words words?
+    static bool fits(DFAProg const &prog)
+    {
+        std::size_t n = 0;
+        for(std::size_t id = 1; id < prog.nodes.size(); ++id)
+            n += prog.nodes[id] != 0;
+        return n <= MaxStates;
+    }
+
+    BitNFA(DFAProg const &prog, bool anchored)
+      : bit(prog.nodes.size(), -1), nchunks(0)
+    {
+        BOOST_ASSERT(fits(prog));
+        int nbits = 0;
+        for(std::size_t id = 1; id < prog.nodes.size(); ++id)
+        {
+            if(prog.nodes[id] != 0)
+                bit[id] = nbits++;
+        }
+        nchunks = (nbits + 7) / 8;
+
+        Set const empty = {{0}, false};
+        std::fill_n(chars, 256, empty);
+        matchmask = startset = empty;
+        startset.match = prog.startmatch;
+        insert(startset, prog.start);
+        std::vector<Set> succ(nbits, empty);
+        for(std::size_t id = 1; id < prog.nodes.size(); ++id)
+        {
+            if(bit[id] < 0)
+                continue;
+            for(int c = 0; c < 256; ++c)
+            {
+                if(prog.accepts(id, c))
+                    set(chars[c], bit[id]);
+            }
+            if(prog.nextmatch[id])
+                set(matchmask, bit[id]);
+            insert(succ[bit[id]], prog.next[id]);
+        }
+
+        // follow[k*256 + b] is the union of the successors of the
+        // states whose bits in the kth byte of the set are b
+        follow.assign(nchunks * 256, empty);
+        for(int k = 0; k < nchunks; ++k)
+        {
+            for(int b = 1; b < 256; ++b)
+            {
+                Set &f = follow[k * 256 + b];
+                for(int j = 0; j < 8 && k * 8 + j < nbits; ++j)
+                {
+                    if(b & (1 << j))
+                        unite(f, succ[k * 8 + j]);
+                }
+            }
+        }
+
+        restart = anchored ? empty : startset;
+    }
+
+    Set start() const
+    {
+        return startset;
+    }
+
+    Set next(Set const &d, int c) const
+    {
+        Set r = restart;
+        Set const &cs = chars[c];
+        for(int i = 0; i < Words; ++i)
+        {
+            boost::uint64_t live = d.w[i] & cs.w[i];
+            if(live & matchmask.w[i])
+                r.match = true;
+            for(int k = i * 8; live != 0; ++k, live >>= 8)
+            {
+                if(live & 0xFF)
+                    unite(r, follow[k * 256 + (live & 0xFF)]);
+            }
+        }
+        return r;
+    }
+
+    bool dead(Set const &d) const
+    {
+        return !d.match && d.w[0] == 0 && d.w[1] == 0;
+    }
+
+    static bool matched(Set const &d)
+    {
+        return d.match;
+    }
+
+    bool atstart(Set const &d) const
+    {
+        return d.match == startset.match
+            && d.w[0] == startset.w[0] && d.w[1] == startset.w[1];
+    }
+
+    // Sets mean the same in every BitNFA over one program.
+    Set import(Set const &d) const
+    {
+        return d;
+    }
+
+private:
+    static void set(Set &s, int b)
+    {
+        s.w[b / 64] |= boost::uint64_t(1) << (b % 64);
+    }
+
+    static void unite(Set &s, Set const &t)
+    {
+        for(int i = 0; i < Words; ++i)
+            s.w[i] |= t.w[i];
+    }
+
+    void insert(Set &s, std::vector<std::size_t> const &ids) const
+    {
+        for(std::size_t j = 0; j < ids.size(); ++j)
+            set(s, bit[ids[j]]);
+    }
+
+    std::vector<int> bit;
+    int nchunks;
+    Set chars[256];
+    Set matchmask, startset, restart;
+    std::vector<Set> follow;
+};
+
+// Is overall match a longer than overall match b?
+// If so, return 1; if not, 0.
+// An incomplete match has no end yet, so it is never longer;
+// its second may be left over from a recycled Capture.
+template<typename Iter>
+int longer(Sub<Iter> const &a, Sub<Iter> const &b)
+{
+    if(a.matched == Unmatched)
+        return 0;
+    if(b.matched == Unmatched || a.first < b.first)
+        return 1;
+    if(a.first == b.first && a.matched == Matched
+        && (b.matched != Matched || a.second > b.second))
+        return 1;
+    return 0;
+}
+
+// A compiled regex: the parsed NFA, the programs the DFAs run,
+// and the options matchers start out with.  None of it changes
+// after construction, so one Regex can be shared by any number of
+// threads as long as each matches with a Matcher of its own.
+struct Regex
+{
+    Regex(REImpl const &impl_, MatchOptions const &opts_ = MatchOptions())
+      : impl(impl_), opts(opts_), fwdprog(impl), revprog(impl, true)
+    {
+        BOOST_ASSERT(impl.prog);
+
+        // small programs are simulated bit-parallel, the rest
+        // with the lazy DFA; the bit-parallel tables are read-only
+        if(BitNFA::fits(fwdprog))
+        {
+            bitfwd.reset(new BitNFA(fwdprog, false));
+            bitfwdanchored.reset(new BitNFA(fwdprog, true));
+            bitrev.reset(new BitNFA(revprog, false));
+            bitrevanchored.reset(new BitNFA(revprog, true));
+        }
+    }
+
+    // Parse and compile re; return null if it does not parse.
+    static boost::shared_ptr<Regex const>
+    compile(char const *re, MatchOptions const &opts = MatchOptions())
+    {
+        REImpl impl;
+        regex_grammar<char const *> parser;
+        char const *begin = re, *end = begin + std::strlen(begin);
+        if(!qi::parse(begin, end, parser(phoenix::ref(impl))) || begin != end)
+            return boost::shared_ptr<Regex const>();
+        impl.compile();
+        return boost::shared_ptr<Regex const>(new Regex(impl, opts));
+    }
+
+    REImpl const impl;
+    MatchOptions const opts;
+    DFAProg const fwdprog, revprog;
+    boost::shared_ptr<BitNFA const> bitfwd, bitfwdanchored, bitrev, bitrevanchored;
+};
+
+// The scratch space for matching a Regex: thread lists, captures
+// and DFA caches.  A Matcher is used by one thread at a time;
+// its options start as the Regex's, and the overloads taking
+// options use theirs for that call only.
+template<typename Iter>
+struct Matcher
+{
+    explicit Matcher(Regex const &re_)
+      : re(re_), impl(re.impl), opts(re.opts), begin(), end(), idle(false)
+      , reqat(), reqknown(false)
+      , nsub(impl.nparen + 1), pool(nsub), empty(pool.alloc()), subs(nsub)
+      , slots(impl.prog->inst.size())
+      , l1(impl.states->size()), l2(impl.states->size()), none(0)
+      , curlist(&l1), nextlist(&l2)
+      , fwd(re.fwdprog, false), fwdanchored(re.fwdprog, true)
+      , rev(re.revprog, false), revanchored(re.revprog, true)
+    {
+        for(std::size_t pc = 0; pc < slots.size(); ++pc)
+        {
+            slots[pc].inst = impl.prog->inst[pc];
+            slots[pc].visits = 0;
+        }
+    }
+
+    // Add pc to l, following unlabeled arrows.
+    // Next character to read is p.
+    // Threads added to l hold a reference to m.
+    void addstate(List<Iter> *l, boost::uint32_t pc, Capture<Iter> *m, Iter icur)
+    {
+        if(pc == 0)
+            return;
+
+        Slot &ss = slots[pc];
+        Thread<Iter> *t = l->find(pc);
+        if(t)
+        {
+            if(++ss.visits > 2)
+                return;
+
+            switch(opts.matchtype)
+            {
+            case LeftmostBiased:
+                if(opts.reptype == RepeatMinimal || ++ss.visits > 2)
+                    return;
+                break;
+            case LeftmostLongest:
+                if(!longer(m->sub[0], t->cap->sub[0]))
+                    return;
+                break;
+            }
+        }
+        else
+        {
+            t = l->add(pc);
+            t->cap = m;
+            pool.incref(m);
+            ss.visits = 1;
+        }
+
+        Inst const &in = ss.inst;
+        switch(in.op)
+        {
+        case Split:
+            // follow unlabeled arrows
+            addstate(l, in.out, m, icur);
+            addstate(l, in.out1, m, icur);
+            break;
+
+        case LParen:
+        {   // record left paren location in a copy and keep going;
+            // m may be shared, and the caller still needs it as is.
+            Capture<Iter> *c = pool.copy(m);
+            c->sub[in.data].first = icur;
+            c->sub[in.data].matched = Incomplete;
+            addstate(l, in.out, c, icur);
+            pool.decref(c);
+        }   break;
+
+        case RParen:
+        {   // record right paren location in a copy and keep going
+            Capture<Iter> *c = pool.copy(m);
+            c->sub[in.data].second = icur;
+            c->sub[in.data].matched = Matched;
+            addstate(l, in.out, c, icur);
+            pool.decref(c);
+        }   break;
+
+        default:
+            break;
+        }
+    }
+
+    // Step the NFA from the states in clist
+    // past the character c,
+    // to create next NFA state set nlist.
+    // Record best match so far in *this.
+    void
+    step(List<Iter> *clist, int c, Iter icur, List<Iter> *nlist)
+    {
+        if(opts.debug)
+        {
+            dumplist(clist, impl.nparen);
+            std::cout << (char)c << " (" << c << ")\n";
+        }
+
+        nlist->n = 0;
+
+        bool cutoff = false;
+        for(int i = 0; i < clist->n && !cutoff; ++i)
+        {
+            Thread<Iter> *t = &clist->t[i];
+
+            if(opts.matchtype == LeftmostLongest)
+            {
+                // stop any threads that are worse than the
+                // leftmost longest found so far.  the threads
+                // will end up ordered on the list by start point,
+                // so if this one is too far right, all the rest are too.
+                if(subs[0].matched != Unmatched && subs[0].first < t->cap->sub[0].first)
+                {
+                    break;
+                }
+            }
+
+            Inst const &in = slots[t->pc].inst;
+            switch(in.op)
+            {
+            case Char:
+                if(c == in.data)
+                {
+                    addstate(nlist, in.out, t->cap, icur);
+                }
+                break;
+
+            case Any:
+                addstate(nlist, in.out, t->cap, icur);
+                break;
+
+            case Match:
+                switch(opts.matchtype)
+                {
+                case LeftmostBiased:
+                    // best so far ...
+                    record(t->cap);
+                    // ... because we cut off the worse ones right now!
+                    cutoff = true;
+                    break;
+                case LeftmostLongest:
+                    if(longer(t->cap->sub[0], subs[0]))
+                    {
+                        record(t->cap);
+                    }
+                    break;
+                default:
+                    break;
+                }
+                break;
+            default:
+                break;
+            }
+        }
+
+        release(clist);
+
+        // start a new thread if no match yet 
+        idle = nlist->n == 0;
+        if(subs[0].matched == Unmatched)
+        {
+            addstate(nlist, impl.prog->start, empty, icur);
+        }
+    }
+
+    // Replace the threads in l with fresh ones starting at icur.
+    void restart(List<Iter> *l, Iter icur)
+    {
+        release(l);
+        addstate(l, impl.prog->start, empty, icur);
+    }
+
+    // Can a match still begin at icur or later?  Every match
+    // contains impl.required.  Where it next occurs is looked up
+    // again only once the scan has passed the last place found,
+    // so the scans read the input for it once over, and only as
+    // far as they get.  A call to match() and the like clears
+    // reqknown before its scan starts.
+    bool viable(Iter icur, Iter iend)
+    {
+        if(impl.required.empty())
+            return true;
+        if(!reqknown || reqat < icur)
+        {
+            reqat = find_literal(icur, iend, impl.required);
+            reqknown = true;
+        }
+        return reqat != iend;
+    }
+
+    // Make the submatches of c the best match so far.
+    void record(Capture<Iter> const *c)
+    {
+        std::copy(c->sub.begin(), c->sub.end(), subs.begin());
+    }
+
+    // Drop the threads in l and their references.
+    void release(List<Iter> *l)
+    {
+        for(int i = 0; i < l->n; ++i)
+            pool.decref(l->t[i].cap);
+        l->n = 0;
+    }
+
+    // Compute initial thread list 
+    List<Iter> *startlist(Iter icur, List<Iter> *l)
+    {
+        subs.assign(nsub, Sub<Iter>());
+        step(&none, 0, icur, l);
+        return l;
+    }
+
+    bool match(Iter icur, Iter iend)
+    {
+        begin = icur; end = iend;
+        reqknown = false;
+        return run(icur);
+    }
+
+    // Match with opts_ for this call only.
+    bool match(Iter icur, Iter iend, MatchOptions const &opts_)
+    {
+        MatchOptions saved = opts;
+        opts = opts_;
+        bool matched = match(icur, iend);
+        opts = saved;
+        return matched;
+    }
+
+    // Run the capture-tracking NFA from icur to end.
+    bool run(Iter icur)
+    {
+        startrun(icur);
+        feed(icur, end, true);
+        return finish(end);
+    }
+
+    // Begin a run of the NFA at icur.  The input is then given
+    // to feed() in as many pieces as convenient, and finish()
+    // ends the run at the end of the input.
+    void startrun(Iter icur)
+    {
+        curlist = startlist(icur, &l1);
+        nextlist = &l2;
+    }
+
+    // Step the NFA over [icur, iend).  Return false if no more
+    // input can change the outcome.  If last, iend is the end of
+    // the input, so the scan can stop once impl.required no
+    // longer occurs ahead.
+    bool feed(Iter icur, Iter iend, bool last = false)
+    {
+        for(; icur != iend && curlist->n > 0; ++icur)
+        {
+            // Only fresh threads left: no match can begin where
+            // the required literal no longer occurs ahead, or
+            // before the next occurrence of the prefix.
+            if(idle && subs[0].matched == Unmatched)
+            {
+                if(last && !viable(icur, iend))
+                {
+                    release(curlist);
+                    break;
+                }
+                if(!impl.prefix.empty())
+                {
+                    Iter next = find_literal(icur, iend, impl.prefix);
+                    if(next == iend)
+                    {
+                        // the prefix may yet begin in the last few
+                        // bytes and end in the next piece of input
+                        std::size_t keep = impl.prefix.size() - 1;
+                        std::size_t left = std::distance(icur, iend);
+                        next = icur;
+                        if(left > keep)
+                            std::advance(next, left - keep);
+                    }
+                    if(next != icur)
+                    {
+                        icur = next;
+                        restart(curlist, icur);
+                        if(icur == iend)
+                            break;
+                    }
+                }
+            }
+
+            int c = *icur & 0xFF;
+            step(curlist, c, boost::next(icur), nextlist);
+            std::swap(curlist, nextlist);
+        }
+        return curlist->n > 0;
+    }
+
+    // End the run; icur is the end of the input.
+    bool finish(Iter icur)
+    {
+        step(curlist, 0, icur, nextlist);
+        release(nextlist);
+        return subs[0].matched == Matched;
+    }
+
+    // Is there a match anywhere in [icur, iend)?
+    // Uses only the DFA; no submatches are tracked.
+    bool search(Iter icur, Iter iend)
+    {
+        reqknown = false;
+        if(re.bitfwd)
+            return search(*re.bitfwd, icur, iend);
+        return search(fwd, icur, iend);
+    }
+
+    // Like match(), but only subs[0], the overall match, is
+    // computed.  The forward DFA rejects non-matching input and
+    // runs on just as far as the matches begun by then reach, the
+    // reversed DFA scans back from there to the leftmost position
+    // where a match begins, and for leftmost-longest the anchored
+    // DFA finds where it ends.  Leftmost-biased ends depend on the order
+    // of alternatives, which a set of states does not keep, so
+    // the NFA is run from the match start to find the end.
+    bool matchspan(Iter icur, Iter iend)
+    {
+        begin = icur; end = iend;
+        subs.assign(nsub, Sub<Iter>());
+        reqknown = false;
+        if(re.bitfwd)
+            return matchspan(*re.bitfwd, *re.bitfwdanchored, *re.bitrev, *re.bitrevanchored);
+        return matchspan(fwd, fwdanchored, rev, revanchored);
+    }
+
+    bool matchspan(Iter icur, Iter iend, MatchOptions const &opts_)
+    {
+        MatchOptions saved = opts;
+        opts = opts_;
+        bool matched = matchspan(icur, iend);
+        opts = saved;
+        return matched;
+    }
+
+    template<typename DFA>
+    bool search(DFA &dfa, Iter icur, Iter iend)
+    {
+        typename DFA::state_type d = dfa.start();
+        for(; !dfa.matched(d) && icur != iend; ++icur)
+        {
+            // back in the start state: give up if the required
+            // literal is not ahead, else skip to the next prefix
+            if(!impl.required.empty() && dfa.atstart(d))
+            {
+                if(!viable(icur, iend))
+                    break;
+                if(!impl.prefix.empty())
+                    icur = find_literal(icur, iend, impl.prefix);
+                if(icur == iend)
+                    break;
+            }
+            d = dfa.next(d, *icur & 0xFF);
+        }
+        return dfa.matched(d);
+    }
+
+    // The scans stay within the matches found, so a caller
+    // stepping through the input match by match reads it a
+    // bounded number of times over.
+    template<typename DFA>
+    bool matchspan(DFA &dfa, DFA &anchored, DFA &reversed, DFA &reversedanchored)
+    {
+        // The first match to end ends at matchend; the leftmost one
+        // began by then, so no threads are started after it.  Every
+        // match begun by then ends by reach.
+        Iter matchend = begin;
+        typename DFA::state_type d = dfa.start();
+        for(; !dfa.matched(d) && matchend != end; ++matchend)
+        {
+            // back in the start state: give up if the required
+            // literal is not ahead, else skip to the next prefix
+            if(!impl.required.empty() && dfa.atstart(d))
+            {
+                if(!viable(matchend, end))
+                    break;
+                if(!impl.prefix.empty())
+                    matchend = find_literal(matchend, end, impl.prefix);
+                if(matchend == end)
+                    break;
+            }
+            d = dfa.next(d, *matchend & 0xFF);
+        }
+        if(!dfa.matched(d))
+            return false;
+
+        Iter reach = matchend;
+        typename DFA::state_type a = anchored.import(d);
+        for(Iter i = matchend; i != end && !anchored.dead(a); )
+        {
+            a = anchored.next(a, *i & 0xFF);
+            ++i;
+            if(anchored.matched(a))
+                reach = i;
+        }
+
+        // No match ends before matchend, so reversed threads are
+        // started from reach back to matchend only, then followed
+        // to where the leftmost of them begins.
+        Iter first = reach, icur = reach;
+        typename DFA::state_type r = reversed.start();
+        while(icur != matchend)
+        {
+            r = reversed.next(r, *--icur & 0xFF);
+            if(reversed.matched(r))
+                first = icur;
+        }
+        r = reversedanchored.import(r);
+        while(icur != begin && !reversedanchored.dead(r))
+        {
+            r = reversedanchored.next(r, *--icur & 0xFF);
+            if(reversedanchored.matched(r))
+                first = icur;
+        }
+
+        if(opts.matchtype == LeftmostBiased)
+            return run(first);
+
+        Iter last = first;
+        d = anchored.start();
+        for(Iter i = first; i != end && !anchored.dead(d); )
+        {
+            d = anchored.next(d, *i & 0xFF);
+            if(anchored.matched(d))
+                last = boost::next(i);
+            ++i;
+        }
+
+        subs[0].first = first;
+        subs[0].second = last;
+        subs[0].matched = Matched;
+        return true;
+    }
+
+    // Does a match begin in [icur, istop)?  Threads are started up
+    // to istop only; the scan then carries on to iend just as far
+    // as the matches already begun can reach.  Needs random access.
+    bool startsin(Iter icur, Iter istop, Iter iend)
+    {
+        return startsin(icur, istop, iend, &never);
+    }
+
+    // Likewise, but stop(i) is asked now and then on the way past
+    // istop; if it says to give up, the answer is a yes that may
+    // be wrong.  Callers that only need a place no match begins
+    // before can bound the scan this way.
+    template<typename Stop>
+    bool startsin(Iter icur, Iter istop, Iter iend, Stop const &stop)
+    {
+        if(re.bitfwd)
+            return startsin(*re.bitfwd, *re.bitfwdanchored, icur, istop, iend, stop);
+        return startsin(fwd, fwdanchored, icur, istop, iend, stop);
+    }
+
+    template<typename DFA, typename Stop>
+    bool startsin(DFA &dfa, DFA &anchored, Iter icur, Iter istop, Iter iend, Stop const &stop)
+    {
+        BOOST_ASSERT(icur < istop);
+
+        // a prefix that begins in the range ends by plimit
+        std::size_t keep = impl.prefix.empty() ? 0 : impl.prefix.size() - 1;
+        Iter plimit = std::size_t(iend - istop) > keep ? istop + keep : iend;
+
+        // the last byte of the range is read anchored, or the
+        // threads started after it would be counted too
+        Iter ilast = boost::prior(istop);
+        typename DFA::state_type d = dfa.start();
+        for(; icur != ilast; ++icur)
+        {
+            if(dfa.matched(d))
+                return true;
+            // back in the start state: skip to the next prefix
+            if(!impl.prefix.empty() && dfa.atstart(d))
+            {
+                icur = find_literal(icur, plimit, impl.prefix);
+                if(!(icur < istop))
+                    return false;
+                if(icur == ilast)
+                    break;
+            }
+            d = dfa.next(d, *icur & 0xFF);
+        }
+        if(dfa.matched(d))
+            return true;
+
+        // the threads of a.*b never die without a b
+        typename DFA::state_type a = anchored.import(d);
+        for(std::size_t n = 1; icur != iend && !anchored.dead(a); ++icur, ++n)
+        {
+            if(n % StopCheckInterval == 0 && stop(icur))
+                return true;
+            a = anchored.next(a, *icur & 0xFF);
+            if(anchored.matched(a))
+                return true;
+        }
+        return false;
+    }
+
+    enum
+    {
+        StopCheckInterval = 1 << 12
+    };
+
+    static bool never(Iter)
+    {
+        return false;
+    }
+
+    void printmatch(std::vector<Sub<Iter> > const &m, int n)
     {
         for(int i = 0; i < n; ++i)
         {
@@ -743,41 +1878,454 @@ struct Matcher
         for(int i=0; i<l->n; ++i)
         {
             Thread<Iter> const *t = &l->t[i];
-            if(t->state->op != Char && t->state->op != Any && t->state->op != Match)
+            int op = slots[t->pc].inst.op;
+            if(op != Char && op != Any && op != Match)
             {
                 continue;
             }
             std::cout << "  ";
-            std::cout << t->state->id << ' ';
-            printmatch(t->match, nparen+1);
+            std::cout << t->pc << ' ';
+            printmatch(t->cap->sub, nparen+1);
             std::cout << '\n';
         }
     }
 
+    Regex const &re;
     REImpl const &impl;
+    MatchOptions opts;
     Iter begin, end;
-    boost::array<Sub<Iter>, NSUB> subs, dummy;
+    bool idle;
+    Iter reqat;
+    bool reqknown;
+    std::size_t nsub;
+    CapturePool<Iter> pool;
+    Capture<Iter> *empty;
+    std::vector<Sub<Iter> > subs;
+    std::vector<Slot> slots;
     List<Iter> l1, l2;
-    Extras<Iter> extras;
+    List<Iter> none; // always empty, the list before the start
+    List<Iter> *curlist, *nextlist;
+    LazyDFA fwd, fwdanchored, rev, revanchored;
+};
+
+// Matchers for one shared Regex, one per thread: a thread's first
+// call to local() makes its Matcher, and later calls reuse it, so
+// threads matching the same Regex take no locks and, once warmed
+// up, allocate nothing.  A thread's Matcher is destroyed when the
+// thread exits; the pool must outlive the threads that use it.
+template<typename Iter>
+struct MatcherPool
+{
+    explicit MatcherPool(boost::shared_ptr<Regex const> const &re_)
+      : re(re_), matchers()
+    {
+        BOOST_ASSERT(re);
+    }
+
+    Matcher<Iter> &local()
+    {
+        Matcher<Iter> *m = matchers.get();
+        if(m == 0)
+        {
+            m = new Matcher<Iter>(*re);
+            matchers.reset(m);
+        }
+        return *m;
+    }
+
+    boost::shared_ptr<Regex const> re;
+    boost::thread_specific_ptr<Matcher<Iter> > matchers;
 };
 
+enum
+{
+    MinSearchChunk = 1 << 16
+};
+
+// The shared part of a parallel_search: the input cut into
+// chunks, the next chunk to look at, and the first chunk known
+// that may hold the start of a match, with none before it.
+// Chunks are handed out in order, so once one is found no thread
+// needs to look past it.
+template<typename Iter>
+struct ChunkSearch
+{
+    ChunkSearch(Regex const &re_, Iter begin_, Iter end_, std::size_t chunk_)
+      : re(re_), begin(begin_), end(end_), chunk(chunk_)
+      , nchunks((end - begin + chunk - 1) / chunk), next(0), found(nchunks)
+    {}
+
+    // The body of a thread of its own.
+    void work()
+    {
+        Matcher<Iter> m(re);
+        run(m);
+    }
+
+    void run(Matcher<Iter> &m)
+    {
+        for(;;)
+        {
+            std::size_t k;
+            {
+                boost::mutex::scoped_lock lock(mutex);
+                if(next >= found)
+                    return;
+                k = next++;
+            }
+            Iter a = begin + k * chunk;
+            Iter b = k + 1 == nchunks ? end : a + chunk;
+            if(m.startsin(a, b, end, GiveUp(*this, k)))
+            {
+                boost::mutex::scoped_lock lock(mutex);
+                found = (std::min)(found, k);
+            }
+        }
+    }
+
+    // When chunk k's scan gives up past the end of the chunk:
+    // once a match is known to begin in an earlier chunk, or a
+    // chunk further on, where the threads may go on forever.  Its
+    // yes then only makes the NFA start there, which is safe.
+    struct GiveUp
+    {
+        GiveUp(ChunkSearch &search_, std::size_t k_)
+          : search(search_), k(k_)
+          , limit(search.end - search.begin > std::ptrdiff_t((k + 2) * search.chunk)
+                ? search.begin + (k + 2) * search.chunk : search.end)
+        {}
+
+        bool operator()(Iter icur) const
+        {
+            if(!(icur < limit))
+                return true;
+            boost::mutex::scoped_lock lock(search.mutex);
+            return search.found < k;
+        }
+
+        ChunkSearch &search;
+        std::size_t k;
+        Iter limit;
+    };
+
+    Regex const &re;
+    Iter begin, end;
+    std::size_t chunk, nchunks, next, found;
+    boost::mutex mutex;
+};
+
+// m.match(icur, iend) with the scan for where the match begins
+// spread over nthreads threads, m's own included; the submatches
+// are the same as match() finds.  Each chunk of the input is asked
+// with the DFA whether a match begins in it, reading at most one
+// chunk past its end, and m then runs the NFA from the start of
+// the first chunk that says yes: threads started before that never
+// reach Match, so leaving them out changes nothing.  A chunk that
+// cannot tell by then says yes, which costs only NFA steps.
+// Iter must be random access.
+template<typename Iter>
+bool parallel_search(Matcher<Iter> &m, Iter icur, Iter iend, int nthreads)
+{
+    std::size_t n = iend - icur;
+    if(nthreads <= 1 || n < 2 * std::size_t(MinSearchChunk))
+        return m.match(icur, iend);
+
+    // a few chunks per thread keep them all busy to the end
+    std::size_t chunk = (std::max)(n / (4 * nthreads), std::size_t(MinSearchChunk));
+    ChunkSearch<Iter> search(m.re, icur, iend, chunk);
+    boost::thread_group threads;
+    for(int i = 1; i < nthreads; ++i)
+        threads.add_thread(new boost::thread(&ChunkSearch<Iter>::work, &search));
+    search.run(m);
+    threads.join_all();
+
+    if(search.found == search.nchunks)
+    {
+        m.begin = icur; m.end = iend;
+        m.subs.assign(m.nsub, Sub<Iter>());
+        return false;
+    }
+    bool matched = m.match(icur + search.found * chunk, iend);
+    m.begin = icur;
+    return matched;
+}
+
+// A position in one chunk of a stream that also knows its absolute
+// offset in the stream.  Positions compare by offset, so the ones
+// that captures recorded in earlier chunks keep their meaning after
+// those chunks are gone; only the offset may be used then.
+struct StreamPos
+{
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef char value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef char const *pointer;
+    typedef char const &reference;
+
+    StreamPos()
+      : p(0), off(0)
+    {}
+
+    StreamPos(char const *p_, std::size_t off_)
+      : p(p_), off(off_)
+    {}
+
+    char const &operator*() const { return *p; }
+    char const &operator[](std::ptrdiff_t n) const { return p[n]; }
+    StreamPos &operator++() { ++p; ++off; return *this; }
+    StreamPos &operator--() { --p; --off; return *this; }
+    StreamPos operator++(int) { StreamPos tmp(*this); ++*this; return tmp; }
+    StreamPos operator--(int) { StreamPos tmp(*this); --*this; return tmp; }
+    StreamPos &operator+=(std::ptrdiff_t n) { p += n; off += n; return *this; }
+    StreamPos &operator-=(std::ptrdiff_t n) { p -= n; off -= n; return *this; }
+
+    friend StreamPos operator+(StreamPos a, std::ptrdiff_t n) { return a += n; }
+    friend StreamPos operator-(StreamPos a, std::ptrdiff_t n) { return a -= n; }
+    friend std::ptrdiff_t operator-(StreamPos const &a, StreamPos const &b) { return std::ptrdiff_t(a.off - b.off); }
+    friend bool operator==(StreamPos const &a, StreamPos const &b) { return a.off == b.off; }
+    friend bool operator!=(StreamPos const &a, StreamPos const &b) { return a.off != b.off; }
+    friend bool operator<(StreamPos const &a, StreamPos const &b) { return a.off < b.off; }
+    friend bool operator>(StreamPos const &a, StreamPos const &b) { return a.off > b.off; }
+    friend bool operator<=(StreamPos const &a, StreamPos const &b) { return a.off <= b.off; }
+    friend bool operator>=(StreamPos const &a, StreamPos const &b) { return a.off >= b.off; }
+
+    char const *p;
+    std::size_t off;
+};
+
+// Chunks are contiguous.
+inline StreamPos find_literal(StreamPos first, StreamPos last, std::string const &lit)
+{
+    return first + (find_literal(first.p, last.p, lit) - first.p);
+}
+
+// Matches a regex against input that arrives in chunks: reads
+// from a file or a socket, segments of a ring buffer.  The NFA's
+// threads and captures are kept between chunks, so nothing has to
+// be buffered, and submatches are reported as absolute offsets.
+// One search per reset(); to look for another match, reset() at
+// the offset to resume from and feed the input from there.
+struct StreamMatcher
+{
+    explicit StreamMatcher(Regex const &re)
+      : m(re), offset(0), live(false)
+    {
+        reset();
+    }
+
+    // Start a new search at absolute offset off.
+    void reset(std::size_t off = 0)
+    {
+        offset = off;
+        m.begin = StreamPos(0, off);
+        m.startrun(m.begin);
+        live = true;
+    }
+
+    // Feed the next n bytes of input.  Return false once
+    // more input cannot change the outcome.
+    bool feed(char const *p, std::size_t n)
+    {
+        StreamPos b(p, offset), e(p + n, offset + n);
+        offset += n;
+        if(live)
+            live = m.feed(b, e);
+        return live;
+    }
+
+    // The input has ended; was there a match?
+    bool finish()
+    {
+        live = false;
+        return m.finish(StreamPos(0, offset));
+    }
+
+    bool matched(int i) const
+    {
+        return m.subs[i].matched == Matched;
+    }
+
+    std::size_t first(int i) const
+    {
+        return m.subs[i].first.off;
+    }
+
+    std::size_t second(int i) const
+    {
+        return m.subs[i].second.off;
+    }
+
+    Matcher<StreamPos> m;
+    std::size_t offset;
+    bool live;
+};
+
+// Several regexes compiled into one NFA.  Each pattern ends in
+// its own Match state whose data is the pattern's id, and compile()
+// hangs the patterns' start states off a fan-out of Splits.
+struct RegexSet
+{
+    RegexSet()
+      : impl(), starts(), compiled(false)
+    {}
+
+    // Add a pattern; return its id, or -1 if it does not parse.
+    int add(char const *re)
+    {
+        BOOST_ASSERT(!compiled);
+        std::size_t nstates = impl.states->size();
+        int nparen = impl.nparen;
+        State const *start = impl.start;
+
+        regex_grammar<char const *> parser;
+        char const *begin = re, *end = begin + std::strlen(begin);
+        if(!qi::parse(begin, end, parser(phoenix::ref(impl))) || begin != end)
+        {
+            // undo the partial parse: its states are half patched,
+            // and compile() looks at every state there is
+            while(impl.states->size() > nstates)
+                impl.states->pop_back();
+            impl.nparen = nparen;
+            impl.npattern = (int)starts.size();
+            impl.start = start;
+            return -1;
+        }
+        starts.push_back(impl.start);
+        prefixes.push_back(REImpl::chain(impl.start));
+        return impl.npattern - 1;
+    }
+
+    void compile()
+    {
+        BOOST_ASSERT(!compiled);
+        State const *s = 0;
+        for(std::size_t i = starts.size(); i-- > 0; )
+            s = s ? impl.state(Split, 0, starts[i], s) : starts[i];
+        impl.start = s;
+        impl.compile();
+
+        // a prefix shared by all the patterns is a prefix of the set
+        impl.prefix = prefixes.empty() ? std::string() : prefixes[0];
+        for(std::size_t i = 1; i < prefixes.size(); ++i)
+        {
+            std::size_t n = 0;
+            while(n < impl.prefix.size() && n < prefixes[i].size() && impl.prefix[n] == prefixes[i][n])
+                ++n;
+            impl.prefix.erase(n);
+        }
+        compiled = true;
+    }
+
+    std::size_t size() const
+    {
+        return starts.size();
+    }
+
+    REImpl impl;
+    std::vector<State const *> starts;
+    std::vector<std::string> prefixes;
+    bool compiled;
+};
+
+// Reports which patterns of a RegexSet match somewhere in the
+// input, in one pass of the lazy DFA over the combined automaton.
+// Only Match states distinguish the patterns, so the DFA states
+// are shared between them.
+template<typename Iter>
+struct SetMatcher
+{
+    explicit SetMatcher(RegexSet const &set_)
+      : set(set_), prog(set.impl), dfa(prog, false)
+    {
+        BOOST_ASSERT(set.compiled);
+    }
+
+    // matched[i] is set if pattern i matches; return whether any does.
+    bool match(Iter icur, Iter iend, std::vector<bool> &matched)
+    {
+        REImpl const &impl = set.impl;
+        matched.assign(set.size(), false);
+        std::size_t left = set.size();
+        if(left == 0)
+            return false;
+
+        // As in Matcher::viable(), where impl.required next occurs
+        // is looked up again only once the scan has passed it.
+        Iter reqat = iend;
+        bool reqknown = false;
+
+        DState *d = dfa.start();
+        note(d, matched, left);
+        for(; left != 0 && icur != iend; ++icur)
+        {
+            // back in the start state: give up if the required
+            // literal is not ahead, else skip to where a match can
+            // begin
+            if(dfa.atstart(d))
+            {
+                if(!impl.required.empty())
+                {
+                    if(!reqknown || reqat < icur)
+                    {
+                        reqat = find_literal(icur, iend, impl.required);
+                        reqknown = true;
+                    }
+                    if(reqat == iend)
+                        break;
+                }
+                if(!impl.prefix.empty())
+                    icur = find_literal(icur, iend, impl.prefix);
+                else if(prog.skipfirst)
+                {
+                    while(icur != iend && !prog.first[*icur & 0xFF])
+                        ++icur;
+                }
+                if(icur == iend)
+                    break;
+            }
+            d = dfa.next(d, *icur & 0xFF);
+            note(d, matched, left);
+        }
+        return left != set.size();
+    }
+
+    RegexSet const &set;
+    DFAProg prog;
+    LazyDFA dfa;
+
+private:
+    static void note(DState const *d, std::vector<bool> &matched, std::size_t &left)
+    {
+        for(std::size_t i = 0; i < d->pats.size(); ++i)
+        {
+            if(!matched[d->pats[i]])
+            {
+                matched[d->pats[i]] = true;
+                --left;
+            }
+        }
+    }
+};
+
+#ifndef NFA_PERL_NO_MAIN
 int main(int argc, char *argv[])
 {
+    MatchOptions opts;
     for(;;)
     {
         if(argc > 1 && std::strcmp(argv[1], "-d") == 0)
         {
-            debug++;
+            opts.debug++;
             argv[1] = argv[0]; --argc; ++argv;
         }
         else if(argc > 1 && std::strcmp(argv[1], "-l") == 0)
         {
-            matchtype = LeftmostLongest;
+            opts.matchtype = LeftmostLongest;
             argv[1] = argv[0]; argc--; argv++;
         }
         else if(argc > 1 && std::strcmp(argv[1], "-p") == 0)
         {
-            reptype = RepeatLikePerl;
+            opts.reptype = RepeatLikePerl;
             argv[1] = argv[0]; argc--; argv++;
         }
         else
@@ -789,28 +2337,57 @@ int main(int argc, char *argv[])
     if(argc < 3)
     {
         std::cerr << "USAGE: " << argv[0] << " <regexp> string...\n";
+        std::cerr << "       a string of - reads standard input in chunks\n";
         return 1;
     }
 
-    REImpl impl;
-    regex_grammar<char const *> regex_parser;
-    const char *begin = argv[1], *end = begin + std::strlen(begin);
-    if (!qi::parse(begin, end, regex_parser(phoenix::ref(impl))) || begin != end)
+    boost::shared_ptr<Regex const> re = Regex::compile(argv[1], opts);
+    if (!re)
     {
         std::cerr << "ERROR: invalid regex\n";
         return 1;
     }
 
-    if(debug)
+    REImpl const &impl = re->impl;
+    if(opts.debug)
     {
         impl.dump();
     }
 
-    Matcher<std::string::const_iterator> m(impl);
+    if(argc == 3 && std::strcmp(argv[2], "-") == 0)
+    {
+        StreamMatcher sm(*re);
+        std::vector<char> buf(64 * 1024);
+        while(std::cin.read(&buf[0], buf.size()) || std::cin.gcount() > 0)
+        {
+            if(!sm.feed(&buf[0], std::cin.gcount()))
+                break;
+        }
+        if(sm.finish())
+        {
+            std::cout << "-: ";
+            for(int i = 0; i <= impl.nparen; ++i)
+            {
+                if(sm.matched(i))
+                    std::cout << '(' << sm.first(i) << ',' << sm.second(i) << ')';
+                else
+                    std::cout << "(?,?)";
+            }
+            std::cout << '\n';
+        }
+        return 0;
+    }
+
+    Matcher<std::string::const_iterator> m(*re);
     for(int i=2; i<argc; ++i)
     {
         std::string str(argv[i]);
-        if(m.match(str.begin(), str.end()))
+        // without parens only the overall match is printed,
+        // which the DFA can find without tracking submatches
+        bool matched = impl.nparen == 0
+          ? m.matchspan(str.begin(), str.end())
+          : m.match(str.begin(), str.end());
+        if(matched)
         {
             std::cout << argv[i] << ": ";
             m.printmatch(m.subs, impl.nparen + 1);
@@ -818,6 +2395,7 @@ int main(int argc, char *argv[])
         }
     }
 }
+#endif
 
 /*
  * Distributed under the Boost Software License, Version 1.0. (See